@@ -15,6 +15,7 @@
  */
 
 #include <fstream>
+#include <sstream>
 #include <time.h>
 #include <sys/time.h>
 #include "ns3/core-module.h"
@@ -33,7 +34,6 @@
 using namespace ns3;
 
 double get_wall_time();
-int GetNodeIdByIpv4 (Ipv4InterfaceContainer container, Ipv4Address addr);
 void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes);
 void PrintTotalStats (nodeStatistics *stats, int totalNodes, double start, double finish, double averageBlockGenIntervalMinutes, bool relayNetwork);
 void PrintBitcoinRegionStats (uint32_t *bitcoinNodesRegions, uint32_t totalNodes);
@@ -54,9 +54,19 @@ main (int argc, char *argv[])
   bool sendheaders = false;
   bool blockTorrent = false;
   bool spv = false;
+  bool trickleInv = false;
+  bool eventCensus = false;
   long blockSize = -1;
   int invTimeoutMins = -1;
   int chunkSize = -1;
+  int setupThreads = 1;
+  std::string partitionProfile;
+  std::string writeProfile;
+  std::string binaryTrace;
+  std::string telemetry;
+  std::string telemetryFormat = "json";
+  double telemetryIntervalMins = 10;
+  double telemetryWallInterval = 10;
   enum Cryptocurrency  cryptocurrency = BITCOIN;
   double tStart = get_wall_time(), tStartSimulation, tFinish;
   const int secsPerMin = 60;
@@ -113,10 +123,7 @@ main (int argc, char *argv[])
   double stop;
 
   Ipv4InterfaceContainer                               ipv4InterfaceContainer;
-  std::map<uint32_t, std::vector<Ipv4Address>>         nodesConnections;
-  std::map<uint32_t, std::map<Ipv4Address, double>>    peersDownloadSpeeds;
-  std::map<uint32_t, std::map<Ipv4Address, double>>    peersUploadSpeeds;
-  std::map<uint32_t, nodeInternetSpeeds>               nodesInternetSpeeds;
+  Ptr<const BitcoinTopology>                           topology;
   std::vector<uint32_t>                                miners;
   int                                                  nodesInSystemId0 = 0;
   
@@ -142,6 +149,16 @@ main (int argc, char *argv[])
   cmd.AddValue ("dogecoin", "Imitate the litecoin network behaviour", dogecoin);
   cmd.AddValue ("blockTorrent", "Enable the BlockTorrent protocol", blockTorrent);
   cmd.AddValue ("spv", "Enable the spv mechanism", spv);
+  cmd.AddValue ("trickleInv", "Batch the block announcements and send them on per-peer Poisson timers", trickleInv);
+  cmd.AddValue ("setupThreads", "The number of threads sampling the topology during setup", setupThreads);
+  cmd.AddValue ("partitionProfile", "Balance the partitions using the profile written by a previous run", partitionProfile);
+  cmd.AddValue ("eventCensus", "Count the events scheduled by the applications by kind and print them per rank", eventCensus);
+  cmd.AddValue ("binaryTrace", "Write the protocol events of each rank to the binary trace <binaryTrace>.<systemId>", binaryTrace);
+  cmd.AddValue ("telemetry", "Report the progress of each rank periodically to <telemetry>.<systemId>", telemetry);
+  cmd.AddValue ("telemetryFormat", "The format of the telemetry: json (JSON lines) or prometheus", telemetryFormat);
+  cmd.AddValue ("telemetryInterval", "The simulated minutes between telemetry reports", telemetryIntervalMins);
+  cmd.AddValue ("telemetryWallInterval", "The minimum wall clock seconds between telemetry reports", telemetryWallInterval);
+  cmd.AddValue ("writeProfile", "Write the per-node load of this run to a partition profile", writeProfile);
 
   cmd.Parse(argc, argv);
  
@@ -245,29 +262,30 @@ main (int argc, char *argv[])
     return 0;
   }
   
+  if (eventCensus)
+    EventCensus::Enable ();
+  if (!writeProfile.empty ())
+    EventCensus::EnableLoadProfile ();
+
   BitcoinTopologyHelper bitcoinTopologyHelper (systemCount, totalNoNodes, noMiners, minersRegions,
                                                cryptocurrency, minConnectionsPerNode, 
-                                               maxConnectionsPerNode, 5, systemId);
+                                               maxConnectionsPerNode, 5, systemId, setupThreads, partitionProfile);
 
   // Install stack on Grid
   InternetStackHelper stack;
-  bitcoinTopologyHelper.InstallStack (stack);
+  bitcoinTopologyHelper.InstallStack (stack, true);
 
   // Assign Addresses to Grid
   bitcoinTopologyHelper.AssignIpv4Addresses (Ipv4AddressHelperCustom ("1.0.0.0", "255.255.255.0", false));
   ipv4InterfaceContainer = bitcoinTopologyHelper.GetIpv4InterfaceContainer();
-  nodesConnections = bitcoinTopologyHelper.GetNodesConnectionsIps();
+  topology = bitcoinTopologyHelper.GetTopology();
   miners = bitcoinTopologyHelper.GetMiners();
-  peersDownloadSpeeds = bitcoinTopologyHelper.GetPeersDownloadSpeeds();
-  peersUploadSpeeds = bitcoinTopologyHelper.GetPeersUploadSpeeds();
-  nodesInternetSpeeds = bitcoinTopologyHelper.GetNodesInternetSpeeds();
   if (systemId == 0)
     PrintBitcoinRegionStats(bitcoinTopologyHelper.GetBitcoinNodesRegions(), totalNoNodes);
 											   
   //Install miners
   BitcoinMinerHelper bitcoinMinerHelper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), bitcoinPort),
-                                          nodesConnections[miners[0]], noMiners, peersDownloadSpeeds[0], peersUploadSpeeds[0],
-                                          nodesInternetSpeeds[0], stats, minersHash[0], averageBlockGenIntervalSeconds);
+                                          topology, noMiners, stats, minersHash[0], averageBlockGenIntervalSeconds);
   ApplicationContainer bitcoinMiners;
   int count = 0;
   if (testScalability == true)
@@ -306,10 +324,7 @@ main (int argc, char *argv[])
         if (spv)
           bitcoinMinerHelper.SetAttribute("SPV", BooleanValue(true));
 	  }
-      bitcoinMinerHelper.SetPeersAddresses (nodesConnections[miner]);
-	  bitcoinMinerHelper.SetPeersDownloadSpeeds (peersDownloadSpeeds[miner]);
-	  bitcoinMinerHelper.SetPeersUploadSpeeds (peersUploadSpeeds[miner]);
-	  bitcoinMinerHelper.SetNodeInternetSpeeds (nodesInternetSpeeds[miner]);
+      bitcoinMinerHelper.SetTopology (topology, miner);
 	  bitcoinMinerHelper.SetNodeStats (&stats[miner]);
       
 	  if(unsolicited)
@@ -339,27 +354,24 @@ main (int argc, char *argv[])
   
   //Install simple nodes
   BitcoinNodeHelper bitcoinNodeHelper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), bitcoinPort), 
-                                        nodesConnections[0], peersDownloadSpeeds[0],  peersUploadSpeeds[0], nodesInternetSpeeds[0], stats);
+                                        topology, stats);
   ApplicationContainer bitcoinNodes;
   
-  for(auto &node : nodesConnections)
+  for(uint32_t node = 0; node < topology->GetNoNodes(); node++)
   {
-    Ptr<Node> targetNode = bitcoinTopologyHelper.GetNode (node.first);
+    Ptr<Node> targetNode = bitcoinTopologyHelper.GetNode (node);
 	
 	if (systemId == targetNode->GetSystemId())
 	{
   
-      if ( std::find(miners.begin(), miners.end(), node.first) == miners.end() )
+      if ( std::find(miners.begin(), miners.end(), node) == miners.end() )
 	  {
 	    if (invTimeoutMins != -1)	 
 	      bitcoinNodeHelper.SetAttribute("InvTimeoutMinutes", TimeValue (Minutes (invTimeoutMins)));
 	    else 	  
           bitcoinNodeHelper.SetAttribute("InvTimeoutMinutes", TimeValue (Minutes (2*averageBlockGenIntervalMinutes)));
-	    bitcoinNodeHelper.SetPeersAddresses (node.second);
-	    bitcoinNodeHelper.SetPeersDownloadSpeeds (peersDownloadSpeeds[node.first]);
-	    bitcoinNodeHelper.SetPeersUploadSpeeds (peersUploadSpeeds[node.first]);
-	    bitcoinNodeHelper.SetNodeInternetSpeeds (nodesInternetSpeeds[node.first]);
-		bitcoinNodeHelper.SetNodeStats (&stats[node.first]);
+	    bitcoinNodeHelper.SetTopology (topology, node);
+		bitcoinNodeHelper.SetNodeStats (&stats[node]);
 		
         if (sendheaders)	  
           bitcoinNodeHelper.SetProtocolType(SENDHEADERS);	
@@ -371,8 +383,10 @@ main (int argc, char *argv[])
           if (spv)
             bitcoinNodeHelper.SetAttribute("SPV", BooleanValue(true));
 		}
+        if (trickleInv)
+          bitcoinNodeHelper.SetAttribute("TrickleInv", BooleanValue(true));
 	    bitcoinNodes.Add(bitcoinNodeHelper.Install (targetNode));
-/*         std::cout << "SystemId " << systemId << ": Node " << node.first << " with systemId = " << targetNode->GetSystemId() 
+/*         std::cout << "SystemId " << systemId << ": Node " << node << " with systemId = " << targetNode->GetSystemId() 
 		          << " was installed in node " << targetNode->GetId () <<  std::endl; */
 				  
 	    if (systemId == 0)
@@ -383,6 +397,39 @@ main (int argc, char *argv[])
   bitcoinNodes.Start (Seconds (start));
   bitcoinNodes.Stop (Minutes (stop));
   
+  BinaryTracer binaryTracer;
+  if (!binaryTrace.empty ())
+  {
+    std::ostringstream traceFile;
+
+    traceFile << binaryTrace << "." << systemId;
+    binaryTracer.Open (traceFile.str (), systemId, bitcoinTopologyHelper.GetBitcoinNodesRegions (), totalNoNodes);
+    for (uint32_t i = 0; i < bitcoinMiners.GetN (); i++)
+      binaryTracer.Connect (bitcoinMiners.Get (i));
+    for (uint32_t i = 0; i < bitcoinNodes.GetN (); i++)
+      binaryTracer.Connect (bitcoinNodes.Get (i));
+  }
+
+  RunTelemetry runTelemetry;
+  if (!telemetry.empty ())
+  {
+    std::ostringstream telemetryFile;
+
+    if (telemetryFormat != "json" && telemetryFormat != "prometheus")
+    {
+      std::cout << "The telemetryFormat must be json or prometheus\n";
+      return 0;
+    }
+
+    telemetryFile << telemetry << "." << systemId;
+    runTelemetry.Start (telemetryFile.str (), telemetryFormat == "json" ? JSON_LINES_TELEMETRY : PROMETHEUS_TELEMETRY,
+                        systemId, Minutes (telemetryIntervalMins), telemetryWallInterval);
+    for (uint32_t i = 0; i < bitcoinMiners.GetN (); i++)
+      runTelemetry.Connect (bitcoinMiners.Get (i));
+    for (uint32_t i = 0; i < bitcoinNodes.GetN (); i++)
+      runTelemetry.Connect (bitcoinNodes.Get (i));
+  }
+
   if (systemId == 0)
     std::cout << "The applications have been setup.\n";
   
@@ -393,17 +440,23 @@ main (int argc, char *argv[])
     std::cout << "Setup time = " << tStartSimulation - tStart << "s\n";
   Simulator::Stop (Minutes (stop + 0.1));
   Simulator::Run ();
+  runTelemetry.Stop ();
   Simulator::Destroy ();
+  binaryTracer.Close ();
+  BITCOIN_PRINT_HANDLER_PROFILE (std::cout, systemId);
+  if (eventCensus)
+    EventCensus::Print (std::cout, systemId);
 
 #ifdef MPI_TEST
 
-  int            blocklen[38] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  int            blocklen[44] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
                                  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}; 
-  MPI_Aint       disp[38]; 
-  MPI_Datatype   dtypes[38] = {MPI_INT, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_INT,
+                                 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, NO_HOP_DELAYS}; 
+  MPI_Aint       disp[44]; 
+  MPI_Datatype   dtypes[44] = {MPI_INT, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_INT,
                                MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG,
-                               MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_INT, MPI_INT, MPI_INT, MPI_LONG, MPI_LONG, MPI_INT}; 
+                               MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_LONG, MPI_INT, MPI_INT, MPI_INT, MPI_LONG, MPI_LONG, MPI_INT,
+                               MPI_LONG, MPI_LONG, MPI_LONG, MPI_DOUBLE, MPI_LONG, MPI_DOUBLE}; 
   MPI_Datatype   mpi_nodeStatisticsType;
 
   disp[0] = offsetof(nodeStatistics, nodeId);
@@ -444,8 +497,14 @@ main (int argc, char *argv[])
   disp[35] = offsetof(nodeStatistics, blockTimeouts);
   disp[36] = offsetof(nodeStatistics, chunkTimeouts);
   disp[37] = offsetof(nodeStatistics, minedBlocksInMainChain);
+  disp[38] = offsetof(nodeStatistics, orphansResolved);
+  disp[39] = offsetof(nodeStatistics, orphansEvicted);
+  disp[40] = offsetof(nodeStatistics, processedEvents);
+  disp[41] = offsetof(nodeStatistics, processingTime);
+  disp[42] = offsetof(nodeStatistics, propagationHops);
+  disp[43] = offsetof(nodeStatistics, meanHopDelays);
 
-  MPI_Type_create_struct (38, blocklen, disp, dtypes, &mpi_nodeStatisticsType);
+  MPI_Type_create_struct (44, blocklen, disp, dtypes, &mpi_nodeStatisticsType);
   MPI_Type_commit (&mpi_nodeStatisticsType);
 
   if (systemId != 0 && systemCount > 1)
@@ -516,6 +575,13 @@ main (int argc, char *argv[])
       stats[recv.nodeId].blockTimeouts = recv.blockTimeouts;
       stats[recv.nodeId].chunkTimeouts = recv.chunkTimeouts;
       stats[recv.nodeId].minedBlocksInMainChain = recv.minedBlocksInMainChain;
+      stats[recv.nodeId].orphansResolved = recv.orphansResolved;
+      stats[recv.nodeId].orphansEvicted = recv.orphansEvicted;
+      stats[recv.nodeId].processedEvents = recv.processedEvents;
+      stats[recv.nodeId].processingTime = recv.processingTime;
+      stats[recv.nodeId].propagationHops = recv.propagationHops;
+      for (int j = 0; j < NO_HOP_DELAYS; j++)
+        stats[recv.nodeId].meanHopDelays[j] = recv.meanHopDelays[j];
 	  count++;
     }
   }	  
@@ -526,6 +592,8 @@ main (int argc, char *argv[])
     tFinish=get_wall_time();
 	
     //PrintStatsForEachNode(stats, totalNoNodes);
+    if (!writeProfile.empty ())
+      BitcoinTopologyHelper::WritePartitionProfile (writeProfile, stats, totalNoNodes);
     PrintTotalStats(stats, totalNoNodes, tStartSimulation, tFinish, averageBlockGenIntervalMinutes, relayNetwork);
 	
     if(unsolicited)
@@ -570,17 +638,6 @@ double get_wall_time()
     return (double)time.tv_sec + (double)time.tv_usec * .000001;
 }
 
-int GetNodeIdByIpv4 (Ipv4InterfaceContainer container, Ipv4Address addr)
-{
-  for (auto it = container.Begin(); it != container.End(); it++)
-  {
-	int32_t interface = it->first->GetInterfaceForAddress (addr);
-	if ( interface != -1)
-      return it->first->GetNetDevice (interface)-> GetNode()->GetId();
-  }	  
-  return -1; //if not found
-}
-
 void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes)
 {
   int secPerMin = 60;
@@ -599,6 +656,11 @@ void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes)
               << 100. * stats[it].staleBlocks / stats[it].totalBlocks << "%)\n";
     std::cout << "The size of the longest fork was " << stats[it].longestFork << " blocks\n";
     std::cout << "There were in total " << stats[it].blocksInForks << " blocks in forks\n";
+    std::cout << "The resolved orphans were " << stats[it].orphansResolved << " and the evicted orphans were " << stats[it].orphansEvicted << "\n";
+    std::cout << "The decomposed propagation hops were " << stats[it].propagationHops << " with mean delays:";
+    for (int i = 0; i < NO_HOP_DELAYS; i++)
+      std::cout << (i == 0 ? " " : ", ") << getHopDelayName (static_cast<enum HopDelay>(i)) << " = " << stats[it].meanHopDelays[i] << "s";
+    std::cout << "\n";
     std::cout << "The total received INV messages were " << stats[it].invReceivedBytes << " Bytes\n";
     std::cout << "The total received GET_HEADERS messages were " << stats[it].getHeadersReceivedBytes << " Bytes\n";
     std::cout << "The total received HEADERS messages were " << stats[it].headersReceivedBytes << " Bytes\n";
@@ -664,6 +726,10 @@ void PrintTotalStats (nodeStatistics *stats, int totalNodes, double start, doubl
   double     chunkSentBytes = 0;
   double     longestFork = 0;
   double     blocksInForks = 0;
+  double     orphansResolved = 0;
+  double     orphansEvicted = 0;
+  double     propagationHops = 0;
+  double     meanHopDelays[NO_HOP_DELAYS] = {};
   double     averageBandwidthPerNode = 0;
   double     connectionsPerNode = 0;
   double     connectionsPerMiner = 0;
@@ -712,6 +778,12 @@ void PrintTotalStats (nodeStatistics *stats, int totalNodes, double start, doubl
     chunkSentBytes = chunkSentBytes*it/static_cast<double>(it + 1) + stats[it].chunkSentBytes/static_cast<double>(it + 1);
     longestFork = longestFork*it/static_cast<double>(it + 1) + stats[it].longestFork/static_cast<double>(it + 1);
     blocksInForks = blocksInForks*it/static_cast<double>(it + 1) + stats[it].blocksInForks/static_cast<double>(it + 1);
+    orphansResolved = orphansResolved*it/static_cast<double>(it + 1) + stats[it].orphansResolved/static_cast<double>(it + 1);
+    orphansEvicted = orphansEvicted*it/static_cast<double>(it + 1) + stats[it].orphansEvicted/static_cast<double>(it + 1);
+    for (int i = 0; i < NO_HOP_DELAYS && stats[it].propagationHops > 0; i++)
+      meanHopDelays[i] = meanHopDelays[i]*propagationHops/(propagationHops + stats[it].propagationHops)
+                       + stats[it].meanHopDelays[i]*stats[it].propagationHops/(propagationHops + stats[it].propagationHops);
+    propagationHops += stats[it].propagationHops;
 	
 	propagationTimes.push_back(stats[it].meanBlockPropagationTime);
 
@@ -784,6 +856,14 @@ void PrintTotalStats (nodeStatistics *stats, int totalNodes, double start, doubl
             << 100. * staleBlocks / totalBlocks << "%)\n";
   std::cout << "The size of the longest fork was " << longestFork << " blocks\n";
   std::cout << "There were in total " << blocksInForks << " blocks in forks\n";
+  std::cout << "The average resolved orphans were " << orphansResolved << " and the average evicted orphans were " << orphansEvicted << "\n";
+  std::cout << "The decomposed propagation hops were " << propagationHops << ", with mean delay per hop:\n";
+  double     meanHopDelay = 0;
+  for (int i = 0; i < NO_HOP_DELAYS; i++)
+    meanHopDelay += meanHopDelays[i];
+  for (int i = 0; i < NO_HOP_DELAYS; i++)
+    std::cout << "  " << getHopDelayName (static_cast<enum HopDelay>(i)) << " = " << meanHopDelays[i] << "s ("
+              << (meanHopDelay > 0 ? 100. * meanHopDelays[i] / meanHopDelay : 0) << "%)\n";
   std::cout << "The average received INV messages were " << invReceivedBytes << " Bytes (" 
             << 100. * invReceivedBytes / averageBandwidthPerNode << "%)\n";
   std::cout << "The average received GET_HEADERS messages were " << getHeadersReceivedBytes << " Bytes (" 
@@ -0,0 +1,482 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Summarizes the binary traces of all the ranks of a run (bitcoin-test --binaryTrace): the block propagation
+ * CDF, the propagation delay per region, the fork and reorganization timelines and the busiest links.
+ * The trace files are memory-mapped and their batches of records are decoded and processed by all the cores.
+ *
+ * Usage: ./waf --run "bitcoin-trace-analyzer --threads=8 --topLinks=10 trace.0 trace.1 ..."
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ns3/core-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+typedef struct {
+  const uint8_t       *encoded;
+  uint32_t             encodedBytes;
+  uint32_t             noRecords;
+} mappedBatch;
+
+typedef struct {
+  uint64_t  block;                 // (height << 32) | minerId
+  uint32_t  nodeId;
+  int64_t   time;                  // ns
+} blockArrival;
+
+/**
+ * The records gathered by one thread from its share of the traces
+ */
+typedef struct {
+  std::vector<blockArrival>              mined;
+  std::vector<blockArrival>              received;
+  std::vector<blockArrival>              validated;
+  std::vector<traceRecord>               reorgs;
+  std::unordered_map<uint64_t, uint64_t> linkBytes;    // key = (nodeId << 32) | peer
+  long                                   messages[EXT_GET_DATA + 1];
+  long                                   timeouts;
+  long                                   orphans;
+  int64_t                                lastTime;
+  bool                                   corrupt;      // A batch of the thread could not be decoded
+} threadRecords;
+
+/**
+ * The nodes which switched to the same new top block
+ */
+typedef struct {
+  uint64_t  newTop;                // (height << 32) | minerId
+  int32_t   oldTopHeight;          // The lowest height of the replaced top blocks
+  int64_t   firstTime;             // ns
+  int64_t   lastTime;              // ns
+  uint32_t  noNodes;
+  uint32_t  maxDepth;
+} reorgSummary;
+
+static uint64_t BlockKey (int32_t height, int32_t minerId);
+static double Percentile (const std::vector<double> &sorted, double p);
+
+int
+main (int argc, char *argv[])
+{
+  int threads = std::max (1u, std::thread::hardware_concurrency ());
+  int topLinks = 10;
+  std::vector<std::string> files;
+  std::vector<mappedBatch> batches;
+  std::vector<uint32_t> nodesRegions;
+
+  CommandLine cmd;
+  cmd.AddValue ("threads", "The number of analysis threads", threads);
+  cmd.AddValue ("topLinks", "The number of busiest links printed", topLinks);
+  cmd.Parse (argc, argv);
+
+  if (threads < 1)
+  {
+    std::cout << "The number of threads must be at least 1\n";
+    return 1;
+  }
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (argv[i][0] != '-')
+      files.push_back (argv[i]);
+  }
+
+  if (files.empty ())
+  {
+    std::cout << "Give the binary traces of the run\n";
+    return 1;
+  }
+
+  /**
+   * Map the traces
+   */
+  for (auto &file : files)
+  {
+    int fd = open (file.c_str (), O_RDONLY);
+    struct stat fileStat;
+
+    if (fd < 0 || fstat (fd, &fileStat) != 0 || static_cast<size_t> (fileStat.st_size) < sizeof (traceFileHeader))
+    {
+      std::cerr << "Cannot read " << file << "\n";
+      return 1;
+    }
+
+    const char *data = static_cast<const char *> (mmap (nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    close (fd);
+    if (data == MAP_FAILED)
+    {
+      std::cerr << "Cannot map " << file << "\n";
+      return 1;
+    }
+
+    const traceFileHeader *header = reinterpret_cast<const traceFileHeader *> (data);
+    size_t recordsOffset = getTraceRecordsOffset (header->noNodes);
+
+    if (std::memcmp (header->magic, "BTCTRACE", 8) != 0 || header->version != 5 || header->recordSize != sizeof (traceRecord)
+        || static_cast<size_t> (fileStat.st_size) < recordsOffset)
+    {
+      std::cerr << file << " is not a binary trace of this version\n";
+      return 1;
+    }
+
+    const uint32_t *regions = reinterpret_cast<const uint32_t *> (data + sizeof (traceFileHeader));
+    nodesRegions.assign (regions, regions + header->noNodes);
+
+    /**
+     * Index the batches, which are decoded in parallel below
+     */
+    size_t offset = recordsOffset;
+    while (offset < static_cast<size_t> (fileStat.st_size))
+    {
+      traceBatchHeader batchHeader;
+
+      if (fileStat.st_size - offset < sizeof (batchHeader))
+        break;
+      std::memcpy (&batchHeader, data + offset, sizeof (batchHeader));
+      offset += sizeof (batchHeader);
+      if (fileStat.st_size - offset < batchHeader.encodedBytes)
+        break;
+
+      mappedBatch batch = {reinterpret_cast<const uint8_t *> (data + offset), batchHeader.encodedBytes, batchHeader.noRecords};
+      batches.push_back (batch);
+      offset += batchHeader.encodedBytes;
+    }
+
+    if (offset != static_cast<size_t> (fileStat.st_size))
+    {
+      std::cerr << file << " is truncated\n";
+      return 1;
+    }
+  }
+
+  /**
+   * Gather the records. Every thread decodes an equal share of the batches of all the traces.
+   */
+  std::vector<threadRecords> gathered (threads);
+
+  ParallelFor (threads, threads, [&] (uint32_t t)
+  {
+    threadRecords &local = gathered[t];
+
+    std::fill (local.messages, local.messages + EXT_GET_DATA + 1, 0);
+    local.timeouts = local.orphans = 0;
+    local.lastTime = 0;
+    local.corrupt = false;
+
+    std::vector<traceRecord> records;
+
+    for (size_t b = batches.size () * t / threads; b < batches.size () * (t + 1) / threads; b++)
+    {
+      if (!decodeTraceRecords (batches[b].encoded, batches[b].encodedBytes, batches[b].noRecords, records))
+      {
+        local.corrupt = true;
+        return;
+      }
+
+      for (auto &record : records)
+      {
+        blockArrival arrival = {BlockKey (record.blockHeight, record.minerId), record.nodeId, record.time};
+
+        local.lastTime = std::max (local.lastTime, record.time);
+        switch (record.eventType)
+        {
+          case BLOCK_MINED_TRACE:
+            local.mined.push_back (arrival);
+            break;
+          case BLOCK_RECEIVED_TRACE:
+            local.received.push_back (arrival);
+            break;
+          case BLOCK_VALIDATED_TRACE:
+            local.validated.push_back (arrival);
+            break;
+          case ORPHAN_ADDED_TRACE:
+            local.orphans++;
+            break;
+          case TIMEOUT_FIRED_TRACE:
+            local.timeouts++;
+            break;
+          case CHAIN_REORG_TRACE:
+            local.reorgs.push_back (record);
+            break;
+          case MESSAGE_SENT_TRACE:
+            local.linkBytes[(static_cast<uint64_t> (record.nodeId) << 32) | record.peer] += record.bytes;
+            if (record.message <= EXT_GET_DATA)
+              local.messages[record.message]++;
+            break;
+        }
+      }
+    }
+  });
+
+  std::unordered_map<uint64_t, int64_t> minedTimes;
+  std::map<int32_t, std::vector<blockArrival>> minedByHeight;
+  int64_t duration = 0;
+  long messages[EXT_GET_DATA + 1] = {};
+  long timeouts = 0, orphans = 0;
+
+  for (auto &local : gathered)
+  {
+    if (local.corrupt)
+    {
+      std::cerr << "A batch of the traces is corrupt\n";
+      return 1;
+    }
+  }
+
+  for (auto &local : gathered)
+  {
+    for (auto &mined : local.mined)
+    {
+      minedTimes[mined.block] = mined.time;
+      minedByHeight[static_cast<int32_t> (mined.block >> 32)].push_back (mined);
+    }
+    for (int i = 0; i <= EXT_GET_DATA; i++)
+      messages[i] += local.messages[i];
+    timeouts += local.timeouts;
+    orphans += local.orphans;
+    duration = std::max (duration, local.lastTime);
+  }
+
+  /**
+   * Compute the propagation delays. Every thread owns the blocks whose key hashes to it, and keeps the
+   * first arrival of each block at each node.
+   */
+  const uint32_t noRegions = OTHER + 1;
+  std::vector<std::vector<double>> threadDelays (threads);
+  std::vector<std::vector<std::vector<double>>> threadRegionDelays (threads, std::vector<std::vector<double>> (noRegions));
+  std::vector<std::vector<double>> threadCoverage50 (threads), threadCoverage90 (threads);
+  uint32_t noNodes = nodesRegions.size ();
+  size_t arrivals50 = std::max<size_t> (std::ceil (0.5 * (noNodes - 1)), 1);     // The arrivals which reach 50% of the other nodes
+  size_t arrivals90 = std::max<size_t> (std::ceil (0.9 * (noNodes - 1)), 1);
+
+  ParallelFor (threads, threads, [&] (uint32_t t)
+  {
+    std::unordered_map<uint64_t, std::unordered_map<uint32_t, int64_t>> firstArrivals;
+
+    for (auto &local : gathered)
+    {
+      for (auto &arrival : local.received)
+      {
+        if (arrival.block % threads != t || minedTimes.find (arrival.block) == minedTimes.end ())
+          continue;
+
+        std::unordered_map<uint32_t, int64_t> &blockArrivals = firstArrivals[arrival.block];
+        std::unordered_map<uint32_t, int64_t>::iterator it = blockArrivals.find (arrival.nodeId);
+
+        if (it == blockArrivals.end () || arrival.time < it->second)
+          blockArrivals[arrival.nodeId] = arrival.time;
+      }
+    }
+
+    for (auto &block : firstArrivals)
+    {
+      int64_t minedTime = minedTimes.find (block.first)->second;
+      std::vector<double> delays;
+
+      for (auto &arrival : block.second)
+      {
+        double delay = (arrival.second - minedTime) / 1e9;
+
+        delays.push_back (delay);
+        if (arrival.first < noNodes && nodesRegions[arrival.first] < noRegions)
+          threadRegionDelays[t][nodesRegions[arrival.first]].push_back (delay);
+      }
+      threadDelays[t].insert (threadDelays[t].end (), delays.begin (), delays.end ());
+
+      /**
+       * The time until the block reached 50% and 90% of the other nodes
+       */
+      std::sort (delays.begin (), delays.end ());
+      if (noNodes > 1 && delays.size () >= arrivals50)
+        threadCoverage50[t].push_back (delays[arrivals50 - 1]);
+      if (noNodes > 1 && delays.size () >= arrivals90)
+        threadCoverage90[t].push_back (delays[arrivals90 - 1]);
+    }
+
+    std::sort (threadDelays[t].begin (), threadDelays[t].end ());
+  });
+
+  std::vector<double> delays, coverage50, coverage90;
+  std::vector<std::vector<double>> regionDelays (noRegions);
+
+  for (int t = 0; t < threads; t++)
+  {
+    std::vector<double> merged;
+
+    std::merge (delays.begin (), delays.end (), threadDelays[t].begin (), threadDelays[t].end (), std::back_inserter (merged));
+    delays.swap (merged);
+    coverage50.insert (coverage50.end (), threadCoverage50[t].begin (), threadCoverage50[t].end ());
+    coverage90.insert (coverage90.end (), threadCoverage90[t].begin (), threadCoverage90[t].end ());
+    for (uint32_t r = 0; r < noRegions; r++)
+      regionDelays[r].insert (regionDelays[r].end (), threadRegionDelays[t][r].begin (), threadRegionDelays[t][r].end ());
+  }
+
+  /**
+   * Print the summaries
+   */
+  const double percentiles[] = {0.1, 0.25, 0.5, 0.75, 0.9, 0.99};
+
+  std::cout << "Traces = " << files.size () << ", nodes = " << noNodes << ", mined blocks = " << minedTimes.size ()
+            << ", simulated time = " << duration / 1e9 << "s\n";
+  std::cout << "Orphans added = " << orphans << ", timeouts fired = " << timeouts << "\n";
+
+  std::cout << "\nPropagation delay CDF over " << delays.size () << " block arrivals:\n";
+  for (auto p : percentiles)
+    std::cout << "  p" << p * 100 << " = " << Percentile (delays, p) << "s\n";
+
+  std::sort (coverage50.begin (), coverage50.end ());
+  std::sort (coverage90.begin (), coverage90.end ());
+  std::cout << "Median time to reach 50% of the nodes = " << Percentile (coverage50, 0.5) << "s, 90% of the nodes = "
+            << Percentile (coverage90, 0.5) << "s\n";
+
+  std::cout << "\nPropagation delay per region (arrivals, median, p90):\n";
+  for (uint32_t r = 0; r < noRegions; r++)
+  {
+    if (regionDelays[r].empty ())
+      continue;
+
+    std::sort (regionDelays[r].begin (), regionDelays[r].end ());
+    std::cout << "  " << getBitcoinRegion (getBitcoinEnum (r)) << ": " << regionDelays[r].size () << ", "
+              << Percentile (regionDelays[r], 0.5) << "s, " << Percentile (regionDelays[r], 0.9) << "s\n";
+  }
+
+  std::cout << "\nFork timeline (height: minerId@minedTime(s)):\n";
+  int forks = 0;
+  for (auto &height : minedByHeight)
+  {
+    if (height.second.size () < 2)
+      continue;
+
+    forks++;
+    std::sort (height.second.begin (), height.second.end (), [] (const blockArrival &a, const blockArrival &b)
+    {
+      return a.time < b.time;
+    });
+    std::cout << "  " << height.first << ":";
+    for (auto &block : height.second)
+      std::cout << " " << static_cast<int32_t> (block.block & 0xffffffff) << "@" << block.time / 1e9;
+    std::cout << "\n";
+  }
+  std::cout << "  " << forks << " heights with competing blocks\n";
+
+  /**
+   * Group the reorganizations of the nodes by the new top block which caused them
+   */
+  std::unordered_map<uint64_t, reorgSummary> reorgsByTop;
+  long noReorgs = 0;
+  uint32_t maxReorgDepth = 0;
+
+  for (auto &local : gathered)
+  {
+    for (auto &reorg : local.reorgs)
+    {
+      uint64_t newTop = BlockKey (reorg.blockHeight, reorg.minerId);
+      std::unordered_map<uint64_t, reorgSummary>::iterator it = reorgsByTop.find (newTop);
+
+      if (it == reorgsByTop.end ())
+      {
+        reorgSummary summary = {newTop, reorg.oldTopHeight, reorg.time, reorg.time, 0, 0};
+        it = reorgsByTop.insert (std::make_pair (newTop, summary)).first;
+      }
+
+      reorgSummary &summary = it->second;
+      summary.oldTopHeight = std::min (summary.oldTopHeight, reorg.oldTopHeight);
+      summary.firstTime = std::min (summary.firstTime, reorg.time);
+      summary.lastTime = std::max (summary.lastTime, reorg.time);
+      summary.noNodes++;
+      summary.maxDepth = std::max (summary.maxDepth, reorg.bytes);
+      noReorgs++;
+      maxReorgDepth = std::max (maxReorgDepth, reorg.bytes);
+    }
+  }
+
+  std::vector<reorgSummary> reorgTimeline;
+  for (auto &top : reorgsByTop)
+    reorgTimeline.push_back (top.second);
+  std::sort (reorgTimeline.begin (), reorgTimeline.end (), [] (const reorgSummary &a, const reorgSummary &b)
+  {
+    return a.firstTime < b.firstTime;
+  });
+
+  std::cout << "\nReorganization timeline (new top height/minerId: nodes, first-last time(s), old top height, max depth):\n";
+  for (auto &summary : reorgTimeline)
+  {
+    std::cout << "  " << static_cast<int32_t> (summary.newTop >> 32) << "/" << static_cast<int32_t> (summary.newTop & 0xffffffff)
+              << ": " << summary.noNodes << ", " << summary.firstTime / 1e9 << "-" << summary.lastTime / 1e9 << ", "
+              << summary.oldTopHeight << ", " << summary.maxDepth << "\n";
+  }
+  std::cout << "  " << noReorgs << " reorganizations, deepest = " << maxReorgDepth << " blocks\n";
+
+  std::cout << "\nMessages sent:";
+  for (int i = 0; i <= EXT_GET_DATA; i++)
+  {
+    if (messages[i] > 0)
+      std::cout << " " << getMessageName (static_cast<enum Messages> (i)) << " = " << messages[i];
+  }
+  std::cout << "\n";
+
+  std::unordered_map<uint64_t, uint64_t> linkBytes;
+  for (auto &local : gathered)
+  {
+    for (auto &link : local.linkBytes)
+      linkBytes[link.first] += link.second;
+  }
+
+  std::vector<std::pair<uint64_t, uint64_t>> links (linkBytes.begin (), linkBytes.end ());
+  size_t printedLinks = std::min<size_t> (topLinks, links.size ());
+  std::partial_sort (links.begin (), links.begin () + printedLinks, links.end (),
+                     [] (const std::pair<uint64_t, uint64_t> &a, const std::pair<uint64_t, uint64_t> &b)
+  {
+    return a.second > b.second;
+  });
+
+  std::cout << "\nBusiest of the " << links.size () << " links (node -> peer: Bytes, average rate):\n";
+  for (size_t i = 0; i < printedLinks; i++)
+  {
+    std::cout << "  " << (links[i].first >> 32) << " -> " << Ipv4Address (static_cast<uint32_t> (links[i].first & 0xffffffff))
+              << ": " << links[i].second << "B, " << (duration > 0 ? links[i].second * 8 / (duration / 1e9) : 0) << "bps\n";
+  }
+
+  return 0;
+}
+
+static uint64_t
+BlockKey (int32_t height, int32_t minerId)
+{
+  return (static_cast<uint64_t> (static_cast<uint32_t> (height)) << 32) | static_cast<uint32_t> (minerId);
+}
+
+static double
+Percentile (const std::vector<double> &sorted, double p)
+{
+  if (sorted.empty ())
+    return 0;
+  return sorted[std::min<size_t> (static_cast<size_t> (p * sorted.size ()), sorted.size () - 1)];
+}
@@ -0,0 +1,92 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Decodes the binary traces written by BinaryTracer (bitcoin-test --binaryTrace) to CSV.
+ *
+ * Usage: ./waf --run "bitcoin-trace-decoder trace.0 trace.1 ..." > trace.csv
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+int 
+main (int argc, char *argv[])
+{
+  std::vector<uint8_t> encoded;
+  std::vector<traceRecord> records;
+
+  /**
+   * The times are printed in seconds with nanosecond resolution, the resolution of the trace
+   */
+  std::cout << std::fixed << std::setprecision (9);
+  std::cout << "time,systemId,node,event,peer,blockHeight,minerId,chunkId,bytes,message,oldTopHeight\n";
+
+  for (int i = 1; i < argc; i++)
+  {
+    FILE *trace = std::fopen (argv[i], "rb");
+    traceFileHeader header;
+
+    if (trace == nullptr)
+    {
+      std::cerr << "Cannot open " << argv[i] << "\n";
+      return 1;
+    }
+
+    if (std::fread (&header, sizeof (header), 1, trace) != 1 || std::memcmp (header.magic, "BTCTRACE", 8) != 0
+        || header.version != 5 || header.recordSize != sizeof (traceRecord))
+    {
+      std::cerr << argv[i] << " is not a binary trace of this version\n";
+      std::fclose (trace);
+      return 1;
+    }
+    std::fseek (trace, getTraceRecordsOffset (header.noNodes), SEEK_SET);
+
+    traceBatchHeader batchHeader;
+    while (std::fread (&batchHeader, sizeof (batchHeader), 1, trace) == 1)
+    {
+      encoded.resize (batchHeader.encodedBytes);
+      if (std::fread (encoded.data (), 1, encoded.size (), trace) != encoded.size ()
+          || !decodeTraceRecords (encoded.data (), encoded.size (), batchHeader.noRecords, records))
+      {
+        std::cerr << argv[i] << " is truncated or corrupt\n";
+        std::fclose (trace);
+        return 1;
+      }
+
+      for (auto &record : records)
+      {
+        std::cout << record.time / 1e9 << "," << header.systemId << "," << record.nodeId << ","
+                  << getTraceEventName (static_cast<enum TraceEventType> (record.eventType)) << ","
+                  << Ipv4Address (record.peer) << "," << record.blockHeight << "," << record.minerId << ","
+                  << record.chunkId << "," << record.bytes << ",";
+        if (record.eventType == MESSAGE_SENT_TRACE)
+          std::cout << getMessageName (static_cast<enum Messages> (record.message));
+        std::cout << "," << record.oldTopHeight << "\n";
+      }
+    }
+    std::fclose (trace);
+  }
+
+  return 0;
+}
@@ -32,7 +32,6 @@
 using namespace ns3;
 
 double get_wall_time();
-int GetNodeIdByIpv4 (Ipv4InterfaceContainer container, Ipv4Address addr);
 void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes);
 void PrintTotalStats (nodeStatistics *stats, int totalNodes, double start, double finish, double averageBlockGenIntervalMinutes);
 void PrintBitcoinRegionStats (uint32_t *bitcoinNodesRegions, uint32_t totalNodes);
@@ -48,6 +47,7 @@ main (int argc, char *argv[])
   bool unsolicited = false;
   bool relayNetwork = false;
   bool unsolicitedRelayNetwork = false;
+  bool globalRouting = false;
   double ud = 0;
   double r = 0;
   enum Cryptocurrency  cryptocurrency = BITCOIN;
@@ -135,6 +135,7 @@ main (int argc, char *argv[])
   cmd.AddValue ("unsolicited", "Change the miners block broadcast type to UNSOLICITED", unsolicited);
   cmd.AddValue ("relayNetwork", "Change the miners block broadcast type to RELAY_NETWORK", relayNetwork);
   cmd.AddValue ("unsolicitedRelayNetwork", "Change the miners block broadcast type to UNSOLICITED_RELAY_NETWORK", unsolicitedRelayNetwork);
+  cmd.AddValue ("globalRouting", "Populate global routing tables instead of routing only to direct neighbors", globalRouting);
   
   cmd.Parse(argc, argv);
   
@@ -146,10 +147,7 @@ main (int argc, char *argv[])
     std::cout << "Iteration : " << iter + 1 << " " << secureBlocks << " " << averageBlockGenIntervalSeconds 
 	          << " " << averageBlockGenIntervalMinutes << " " << targetNumberOfBlocks << "\n";
     Ipv4InterfaceContainer                               ipv4InterfaceContainer;
-    std::map<uint32_t, std::vector<Ipv4Address>>         nodesConnections;
-    std::map<uint32_t, std::map<Ipv4Address, double>>    peersDownloadSpeeds;
-    std::map<uint32_t, std::map<Ipv4Address, double>>    peersUploadSpeeds;
-    std::map<uint32_t, nodeInternetSpeeds>               nodesInternetSpeeds;
+    Ptr<const BitcoinTopology>                           topology;
     std::vector<uint32_t>                                miners;
   
 	
@@ -159,24 +157,20 @@ main (int argc, char *argv[])
 
     // Install stack on Grid
     InternetStackHelper stack;
-    bitcoinTopologyHelper.InstallStack (stack);
+    bitcoinTopologyHelper.InstallStack (stack, !globalRouting);
 
     // Assign Addresses to Grid
     bitcoinTopologyHelper.AssignIpv4Addresses (Ipv4AddressHelperCustom ("1.0.0.0", "255.255.255.0", false));
     ipv4InterfaceContainer = bitcoinTopologyHelper.GetIpv4InterfaceContainer();
-    nodesConnections = bitcoinTopologyHelper.GetNodesConnectionsIps();
+    topology = bitcoinTopologyHelper.GetTopology();
     miners = bitcoinTopologyHelper.GetMiners();
-    peersDownloadSpeeds = bitcoinTopologyHelper.GetPeersDownloadSpeeds();
-    peersUploadSpeeds = bitcoinTopologyHelper.GetPeersUploadSpeeds();
-    nodesInternetSpeeds = bitcoinTopologyHelper.GetNodesInternetSpeeds();
     if (systemId == 0)
       PrintBitcoinRegionStats(bitcoinTopologyHelper.GetBitcoinNodesRegions(), totalNoNodes);
 
 
     //Install miners
     BitcoinMinerHelper bitcoinMinerHelper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), bitcoinPort),
-                                            nodesConnections[miners[0]], noMiners, peersDownloadSpeeds[0], peersUploadSpeeds[0], nodesInternetSpeeds[0], 
-										    stats, minersHash[0], averageBlockGenIntervalSeconds);
+                                            topology, noMiners, stats, minersHash[0], averageBlockGenIntervalSeconds);
     ApplicationContainer bitcoinMiners;
     int count = 0;
 	
@@ -194,10 +188,8 @@ main (int argc, char *argv[])
         }
 		
         bitcoinMinerHelper.SetAttribute("HashRate", DoubleValue(minersHash[count]));
-	    bitcoinMinerHelper.SetPeersAddresses (nodesConnections[miner]);
+	    bitcoinMinerHelper.SetTopology (topology, miner);
 	    bitcoinMinerHelper.SetNodeStats (&stats[miner]);
-	    bitcoinMinerHelper.SetPeersDownloadSpeeds (peersDownloadSpeeds[miner]);
-	    bitcoinMinerHelper.SetPeersUploadSpeeds (peersUploadSpeeds[miner]);
 
         if (test == true && attackerId != miner)
           bitcoinMinerHelper.SetAttribute("FixedBlockIntervalGeneration", DoubleValue(100));
@@ -227,7 +219,8 @@ main (int argc, char *argv[])
 
   
     // Set up the actual simulation
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    if (globalRouting)
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
   
     Simulator::Stop (Minutes (stop + 0.1));
 	
@@ -282,17 +275,6 @@ double get_wall_time()
     return (double)time.tv_sec + (double)time.tv_usec * .000001;
 }
 
-int GetNodeIdByIpv4 (Ipv4InterfaceContainer container, Ipv4Address addr)
-{
-  for (auto it = container.Begin(); it != container.End(); it++)
-  {
-	int32_t interface = it->first->GetInterfaceForAddress (addr);
-	if ( interface != -1)
-      return it->first->GetNetDevice (interface)-> GetNode()->GetId();
-  }	  
-  return -1; //if not found
-}
-
 void PrintStatsForEachNode (nodeStatistics *stats, int totalNodes)
 {
   int secPerMin = 60;
@@ -32,6 +32,29 @@ BitcoinMinerHelper::BitcoinMinerHelper (std::string protocol, Address address, s
 
 }
 
+BitcoinMinerHelper::BitcoinMinerHelper (std::string protocol, Address address, Ptr<const BitcoinTopology> topology, int noMiners,
+                                        nodeStatistics *stats, double hashRate, double averageBlockGenIntervalSeconds) : 
+                                        BitcoinNodeHelper (),  m_minerType (NORMAL_MINER), m_blockBroadcastType (STANDARD),
+                                        m_secureBlocks (6), m_blockGenBinSize (-1), m_blockGenParameter (-1)
+{
+  std::vector<Ipv4Address>       peers;
+  std::map<Ipv4Address, double>  peersSpeeds;
+  nodeInternetSpeeds             internetSpeeds = topology->GetNodeInternetSpeeds (0);
+
+  m_factory.SetTypeId ("ns3::BitcoinMiner");
+  commonConstructor(protocol, address, peers, peersSpeeds, peersSpeeds, internetSpeeds, stats);
+  SetTopology (topology, 0);
+  
+  m_noMiners = noMiners;
+  m_hashRate = hashRate;
+  m_averageBlockGenIntervalSeconds = averageBlockGenIntervalSeconds;
+  
+  m_factory.Set ("NumberOfMiners", UintegerValue(m_noMiners));
+  m_factory.Set ("HashRate", DoubleValue(m_hashRate));
+  m_factory.Set ("AverageBlockGenIntervalSeconds", DoubleValue(m_averageBlockGenIntervalSeconds));
+
+}
+
 Ptr<Application>
 BitcoinMinerHelper::InstallPriv (Ptr<Node> node) //FIX ME
 {
@@ -41,13 +64,8 @@ BitcoinMinerHelper::InstallPriv (Ptr<Node> node) //FIX ME
       case NORMAL_MINER: 
       {
         Ptr<BitcoinMiner> app = m_factory.Create<BitcoinMiner> ();
-        app->SetPeersAddresses(m_peersAddresses);
-        app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
-        app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
-        app->SetNodeInternetSpeeds(m_internetSpeeds);
-        app->SetNodeStats(m_nodeStats);
+        SetUpApplication (app);
         app->SetBlockBroadcastType(m_blockBroadcastType);
-        app->SetProtocolType(m_protocolType);
 
         node->AddApplication (app);
         return app;
@@ -55,13 +73,8 @@ BitcoinMinerHelper::InstallPriv (Ptr<Node> node) //FIX ME
       case SIMPLE_ATTACKER: 
       {
         Ptr<BitcoinSimpleAttacker> app = m_factory.Create<BitcoinSimpleAttacker> ();
-        app->SetPeersAddresses(m_peersAddresses);
-        app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
-        app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
-        app->SetNodeInternetSpeeds(m_internetSpeeds);
-        app->SetNodeStats(m_nodeStats);
+        SetUpApplication (app);
         app->SetBlockBroadcastType(m_blockBroadcastType);
-        app->SetProtocolType(m_protocolType);
 
         node->AddApplication (app);
         return app;
@@ -69,13 +82,8 @@ BitcoinMinerHelper::InstallPriv (Ptr<Node> node) //FIX ME
       case SELFISH_MINER: 
       {
         Ptr<BitcoinSelfishMiner> app = m_factory.Create<BitcoinSelfishMiner> ();
-        app->SetPeersAddresses(m_peersAddresses);
-        app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
-        app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
-        app->SetNodeInternetSpeeds(m_internetSpeeds);
-        app->SetNodeStats(m_nodeStats);
+        SetUpApplication (app);
         app->SetBlockBroadcastType(m_blockBroadcastType);
-        app->SetProtocolType(m_protocolType);
 
         node->AddApplication (app);
         return app;
@@ -83,13 +91,8 @@ BitcoinMinerHelper::InstallPriv (Ptr<Node> node) //FIX ME
       case SELFISH_MINER_TRIALS: 
       {
         Ptr<BitcoinSelfishMinerTrials> app = m_factory.Create<BitcoinSelfishMinerTrials> ();
-        app->SetPeersAddresses(m_peersAddresses);
-        app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
-        app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
-        app->SetNodeInternetSpeeds(m_internetSpeeds);
-        app->SetNodeStats(m_nodeStats);
+        SetUpApplication (app);
         app->SetBlockBroadcastType(m_blockBroadcastType);
-        app->SetProtocolType(m_protocolType);
 
         node->AddApplication (app);
         return app;
@@ -40,6 +40,21 @@ class BitcoinMinerHelper : public BitcoinNodeHelper
   BitcoinMinerHelper (std::string protocol, Address address, std::vector<Ipv4Address> peers, int noMiners,
                       std::map<Ipv4Address, double> &peersDownloadSpeeds, std::map<Ipv4Address, double> &peersUploadSpeeds,
                       nodeInternetSpeeds &internetSpeeds, nodeStatistics *stats, double hashRate, double averageBlockGenIntervalSeconds);
+
+  /**
+   * Create a BitcoinMinerHelper which installs miners sharing the given topology.
+   * The node of each installed miner is selected with SetTopology.
+   *
+   * \param protocol the name of the protocol to use to receive traffic
+   * \param address the address of the bitcoin node
+   * \param topology the shared topology of the network
+   * \param noMiners total number of miners in the simulation
+   * \param stats a pointer to struct holding the node statistics
+   * \param hashRate the hash rate of the miner
+   * \param averageBlockGenIntervalSeconds the average block generation interval in seconds
+   */
+  BitcoinMinerHelper (std::string protocol, Address address, Ptr<const BitcoinTopology> topology, int noMiners,
+                      nodeStatistics *stats, double hashRate, double averageBlockGenIntervalSeconds);
 					  
   enum MinerType GetMinerType(void);
   void SetMinerType (enum MinerType m);
@@ -18,7 +18,18 @@ BitcoinNodeHelper::BitcoinNodeHelper (std::string protocol, Address address, std
   commonConstructor (protocol, address, peers, peersDownloadSpeeds, peersUploadSpeeds, internetSpeeds, stats);
 }
 
-BitcoinNodeHelper::BitcoinNodeHelper (void)
+BitcoinNodeHelper::BitcoinNodeHelper (std::string protocol, Address address, Ptr<const BitcoinTopology> topology, nodeStatistics *stats)
+{
+  std::vector<Ipv4Address>       peers;
+  std::map<Ipv4Address, double>  peersSpeeds;
+  nodeInternetSpeeds             internetSpeeds = topology->GetNodeInternetSpeeds (0);
+
+  m_factory.SetTypeId ("ns3::BitcoinNode");
+  commonConstructor (protocol, address, peers, peersSpeeds, peersSpeeds, internetSpeeds, stats);
+  SetTopology (topology, 0);
+}
+
+BitcoinNodeHelper::BitcoinNodeHelper (void) : m_topologyNodeId (0)
 {
 }
 
@@ -35,6 +46,8 @@ BitcoinNodeHelper::commonConstructor(std::string protocol, Address address, std:
   m_internetSpeeds = internetSpeeds;
   m_nodeStats = stats;
   m_protocolType = STANDARD_PROTOCOL;
+  m_topology = 0;
+  m_topologyNodeId = 0;
   
   m_factory.Set ("Protocol", StringValue (m_protocol));
   m_factory.Set ("Local", AddressValue (m_address));
@@ -77,18 +90,29 @@ Ptr<Application>
 BitcoinNodeHelper::InstallPriv (Ptr<Node> node)
 {
   Ptr<BitcoinNode> app = m_factory.Create<BitcoinNode> ();
-  app->SetPeersAddresses(m_peersAddresses);
-  app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
-  app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
-  app->SetNodeInternetSpeeds(m_internetSpeeds);
-  app->SetNodeStats(m_nodeStats);
-  app->SetProtocolType(m_protocolType);
+  SetUpApplication (app);
 
   node->AddApplication (app);
 
   return app;
 }
 
+void
+BitcoinNodeHelper::SetUpApplication (Ptr<BitcoinNode> app)
+{
+  if (m_topology)
+    app->SetTopology(m_topology, m_topologyNodeId);
+  else
+  {
+    app->SetPeersAddresses(m_peersAddresses);
+    app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
+    app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
+    app->SetNodeInternetSpeeds(m_internetSpeeds);
+  }
+  app->SetNodeStats(m_nodeStats);
+  app->SetProtocolType(m_protocolType);
+}
+
 void 
 BitcoinNodeHelper::SetPeersAddresses (std::vector<Ipv4Address> &peersAddresses)
 {
@@ -114,6 +138,13 @@ BitcoinNodeHelper::SetNodeInternetSpeeds (nodeInternetSpeeds &internetSpeeds)
   m_internetSpeeds = internetSpeeds;	
 }
 
+void 
+BitcoinNodeHelper::SetTopology (Ptr<const BitcoinTopology> topology, uint32_t nodeId)
+{
+  m_topology = topology;
+  m_topologyNodeId = nodeId;
+}
+
 void 
 BitcoinNodeHelper::SetNodeStats (nodeStatistics *nodeStats)
 {
@@ -14,6 +14,8 @@
 
 namespace ns3 {
 
+class BitcoinNode;
+
 /**
  * Based on packet-sink-helper
  */
@@ -38,6 +40,17 @@ public:
   BitcoinNodeHelper (std::string protocol, Address address, std::vector<Ipv4Address> &peers, 
                      std::map<Ipv4Address, double> &peersDownloadSpeeds, std::map<Ipv4Address, double> &peersUploadSpeeds,
                      nodeInternetSpeeds &internetSpeeds, nodeStatistics *stats);
+
+  /**
+   * Create a BitcoinNodeHelper which installs applications sharing the given topology.
+   * The node of each installed application is selected with SetTopology.
+   *
+   * \param protocol the name of the protocol to use to receive traffic
+   * \param address the address of the bitcoin node
+   * \param topology the shared topology of the network
+   * \param stats a pointer to struct holding the node statistics
+   */
+  BitcoinNodeHelper (std::string protocol, Address address, Ptr<const BitcoinTopology> topology, nodeStatistics *stats);
   
   /**
    * Called by subclasses to set a different factory TypeId
@@ -104,6 +117,16 @@ public:
   
   void SetNodeInternetSpeeds (nodeInternetSpeeds &internetSpeeds);
 
+  /**
+   * Makes the next installed application take its peers, their speeds and its internet speeds from the shared
+   * topology (instead of the values given by SetPeersAddresses, SetPeersDownloadSpeeds, SetPeersUploadSpeeds
+   * and SetNodeInternetSpeeds).
+   *
+   * \param topology the shared topology of the network
+   * \param nodeId the id of the node in the topology
+   */
+  void SetTopology (Ptr<const BitcoinTopology> topology, uint32_t nodeId);
+
   void SetNodeStats (nodeStatistics *nodeStats);
 
   void SetProtocolType (enum ProtocolType protocolType);
@@ -117,6 +140,11 @@ protected:
    * \returns Ptr to the application installed.
    */
   virtual Ptr<Application> InstallPriv (Ptr<Node> node);
+
+  /**
+   * Passes the peers, the speeds and the statistics to a newly created application
+   */
+  void SetUpApplication (Ptr<BitcoinNode> app);
   
   ObjectFactory                                       m_factory;              //!< Object factory.
   std::string                                         m_protocol;             //!< The name of the protocol to use to receive traffic
@@ -125,6 +153,8 @@ protected:
   std::map<Ipv4Address, double>                       m_peersDownloadSpeeds;  //!< The download speeds of the peers
   std::map<Ipv4Address, double>                       m_peersUploadSpeeds;    //!< The upload speeds of the peers
   nodeInternetSpeeds                                  m_internetSpeeds;       //!< The internet speeds of the node
+  Ptr<const BitcoinTopology>                          m_topology;             //!< The shared topology, if the peers are taken from it
+  uint32_t                                            m_topologyNodeId;       //!< The id of the node in m_topology
   nodeStatistics                                      *m_nodeStats;           //!< The struct holding the node statistics
   enum ProtocolType									  m_protocolType;         //!< The protocol that the nodes use to advertise new blocks (DEFAULT: STANDARD)
 
@@ -31,6 +31,7 @@
 #include "ipv4-address-helper-custom.h"
 #include "ns3/bitcoin.h"
 #include <random>
+#include <string>
 
 namespace ns3 {
 
@@ -54,10 +55,19 @@ public:
    * \param pointToPoint the PointToPointHelper which is used 
    *                     to connect all of the nodes together 
    *                     in the grid
+   *
+   * \param noSetupThreads the number of threads sampling the regions and speeds of the nodes
+   *                       and the attributes of the links. Each node and link uses its own
+   *                       random substream, so the topology does not depend on it.
+   *
+   * \param partitionProfile a profile written by WritePartitionProfile in a previous run. If it is given,
+   *                         the nodes are assigned to the noCpus systems so that their measured load is
+   *                         balanced, instead of round robin.
    */
   BitcoinTopologyHelper (uint32_t noCpus, uint32_t totalNoNodes, uint32_t noMiners, enum BitcoinRegion *minersRegions,
                          enum Cryptocurrency cryptocurrency, int minConnectionsPerNode, int maxConnectionsPerNode, 
-                         double latencyParetoShapeDivider, uint32_t systemId);
+                         double latencyParetoShapeDivider, uint32_t systemId, uint32_t noSetupThreads = 1,
+                         std::string partitionProfile = "");
 
   ~BitcoinTopologyHelper ();
 
@@ -93,8 +103,13 @@ public:
   /**
    * \param stack an InternetStackHelper which is used to install 
    *              on every node in the grid
+   *
+   * \param neighborRouting if true, the nodes only use static routing, which knows just the
+   *                        directly attached /24 of each of their links. Since the bitcoin nodes
+   *                        only talk to their direct peers, this is enough and the routing tables
+   *                        are O(degree). Ipv4GlobalRoutingHelper::PopulateRoutingTables must not be called.
    */
-  void InstallStack (InternetStackHelper stack);
+  void InstallStack (InternetStackHelper stack, bool neighborRouting = false);
 
   /**
    * Assigns Ipv4 addresses to all the row and column interfaces
@@ -124,21 +139,71 @@ public:
    */
    Ipv4InterfaceContainer GetIpv4InterfaceContainer (void) const;
    
-   std::map<uint32_t, std::vector<Ipv4Address>> GetNodesConnectionsIps (void) const;
+   /**
+    * Gets the shared, immutable topology built by AssignIpv4Addresses: the peers' addresses and speeds of each node
+    * and the internet speeds of the nodes. Installed applications view it in place instead of copying it.
+    */
+   Ptr<const BitcoinTopology> GetTopology (void) const;
    
    std::vector<uint32_t> GetMiners (void) const;
    
    uint32_t* GetBitcoinNodesRegions (void);
-   
-   std::map<uint32_t, std::map<Ipv4Address, double>> GetPeersDownloadSpeeds(void) const;
-   std::map<uint32_t, std::map<Ipv4Address, double>> GetPeersUploadSpeeds(void) const;
 
-   std::map<uint32_t, nodeInternetSpeeds> GetNodesInternetSpeeds (void) const;
+   /**
+    * Gets the wall clock time in seconds spent in each setup stage (connections, node creation, node sampling,
+    * link sampling, link installation, stack installation and address assignment), in the order they ran.
+    */
+   std::vector<std::pair<std::string, double>> GetSetupStageTimes (void) const;
+
+   /**
+    * Writes the processed events and the processing time of each node to a profile, which can be passed
+    * to the constructor of the next run to balance the load of the partitions.
+    *
+    * \param fileName the profile to write
+    * \param stats the statistics of the nodes, as gathered in systemId 0
+    * \param totalNoNodes the number of entries in stats
+    */
+   static void WritePartitionProfile (const std::string &fileName, const nodeStatistics *stats, uint32_t totalNoNodes);
+   
 
 private:
 
-  void AssignRegion (uint32_t id);
-  void AssignInternetSpeeds(uint32_t id);
+  enum SetupStage
+  {
+    NODE_SAMPLING_STAGE,
+    LINK_SAMPLING_STAGE
+  };
+
+  void AssignRegion (uint32_t id, std::default_random_engine &generator);
+  void AssignInternetSpeeds(uint32_t id, std::default_random_engine &generator);
+
+  /**
+   * Computes the bandwidth (the minimum of the nodes' internet speeds, in Mbps) and draws the latency
+   * (based on the regions of the nodes, in ms) of the link between node1 and node2.
+   * It only reads the helper's state, so it can run on the worker threads.
+   */
+  void SampleLink (uint32_t node1, uint32_t node2, std::default_random_engine &generator, double &bandwidth, double &latency) const;
+
+  /**
+   * Creates the point-to-point link between node1 and node2 with the given bandwidth in Mbps and latency in ms
+   */
+  void InstallLink (PointToPointHelper &pointToPoint, uint32_t node1, uint32_t node2, double bandwidth, double latency);
+
+  /**
+   * Returns the random substream of the entity id (node or link) in a setup stage
+   */
+  std::default_random_engine GetSubstream (enum SetupStage stage, uint32_t id) const;
+
+  /**
+   * \brief Assigns the nodes to the systems. Without a profile the nodes are assigned round robin. Otherwise,
+   *        the heaviest remaining node is repeatedly assigned to the least loaded system. The nodes missing
+   *        from the profile weigh as much as the average profiled node.
+   * \param partitionProfile the profile written by WritePartitionProfile, or an empty string
+   */
+  void PartitionNodes (const std::string &partitionProfile);
+
+  void RecordSetupStage (const std::string &stage, double seconds);
+  double GetSetupStageTime (const std::string &stage) const;
   
   uint32_t     m_totalNoNodes;                  //!< The total number of nodes
   uint32_t     m_noMiners;                      //!< The total number of miners
@@ -152,42 +217,44 @@ private:
   double       m_minerUploadSpeed;              //!<  The upload speed of miners
   uint32_t     m_totalNoLinks;                  //!<  Total number of links
   uint32_t     m_systemId;
+  uint32_t     m_noSetupThreads;                //!<  The number of threads used by the parallel setup stages
+  static const uint32_t m_setupSeed = 1000;     //!<  The seed of the setup substreams
   
   enum BitcoinRegion                             *m_minersRegions;
   enum Cryptocurrency                             m_cryptocurrency;
   std::vector<uint32_t>                           m_miners;                  //!< The ids of the miners
   std::map<uint32_t, std::vector<uint32_t>>       m_nodesConnections;        //!< key = nodeId
-  std::map<uint32_t, std::vector<Ipv4Address>>    m_nodesConnectionsIps;     //!< key = nodeId
   std::vector<NodeContainer>                      m_nodes;                   //!< all the nodes in the network
+  std::vector<uint32_t>                           m_nodesSystemId;           //!< The system of each node, index = nodeId
   std::vector<NetDeviceContainer>                 m_devices;                 //!< NetDevices in the network
   std::vector<Ipv4InterfaceContainer>             m_interfaces;              //!< IPv4 interfaces in the network
   uint32_t                                       *m_bitcoinNodesRegion;      //!< The region in which the bitcoin nodes are located
   double                                          m_regionLatencies[6][6];   //!< The inter- and intra-region latencies
   double                                          m_regionDownloadSpeeds[6];     
   double                                          m_regionUploadSpeeds[6];     
+  std::vector<std::pair<std::string, double>>     m_setupStageTimes;         //!< The wall clock time of each setup stage
   
 
-  std::map<uint32_t, std::map<Ipv4Address, double>>    m_peersDownloadSpeeds;     //!< key1 = nodeId, key2 = Ipv4Address of peer
-  std::map<uint32_t, std::map<Ipv4Address, double>>    m_peersUploadSpeeds;       //!< key1 = nodeId, key2 = Ipv4Address of peer
-  std::map<uint32_t, nodeInternetSpeeds>               m_nodesInternetSpeeds;     //!< key = nodeId
+  Ptr<const BitcoinTopology>                           m_topology;                //!< The peers and speeds of all the nodes, built by AssignIpv4Addresses
+  std::vector<nodeInternetSpeeds>                      m_nodesInternetSpeeds;     //!< index = nodeId
   std::map<uint32_t, int>                              m_minConnections;          //!< key = nodeId
   std::map<uint32_t, int>                              m_maxConnections;          //!< key = nodeId
 
   std::default_random_engine                     m_generator;
-  std::piecewise_constant_distribution<double>   m_nodesDistribution;
-  std::piecewise_constant_distribution<double>   m_connectionsDistribution;
-  std::piecewise_constant_distribution<double>   m_europeDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_europeUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_northAmericaDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_northAmericaUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_asiaPacificDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_asiaPacificUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_japanDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_japanUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_southAmericaDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_southAmericaUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_australiaDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_australiaUploadBandwidthDistribution;
+  AliasSampler                                   m_nodesDistribution;
+  AliasSampler                                   m_connectionsDistribution;
+  AliasSampler                                   m_europeDownloadBandwidthDistribution;
+  AliasSampler                                   m_europeUploadBandwidthDistribution;
+  AliasSampler                                   m_northAmericaDownloadBandwidthDistribution;
+  AliasSampler                                   m_northAmericaUploadBandwidthDistribution;
+  AliasSampler                                   m_asiaPacificDownloadBandwidthDistribution;
+  AliasSampler                                   m_asiaPacificUploadBandwidthDistribution;
+  AliasSampler                                   m_japanDownloadBandwidthDistribution;
+  AliasSampler                                   m_japanUploadBandwidthDistribution;
+  AliasSampler                                   m_southAmericaDownloadBandwidthDistribution;
+  AliasSampler                                   m_southAmericaUploadBandwidthDistribution;
+  AliasSampler                                   m_australiaDownloadBandwidthDistribution;
+  AliasSampler                                   m_australiaUploadBandwidthDistribution;
 };
 
 
@@ -163,7 +163,7 @@ protected:
   int                                            m_nextBlockSize;
   int                                            m_maxBlockSize;
   double                                         m_minerAverageBlockSize;
-  std::piecewise_constant_distribution<double>   m_blockSizeDistribution;
+  const AliasSampler                            *m_blockSizeSampler;       //!< The block size distribution (in KBytes), shared by all the miners
   
   const double  m_realAverageBlockGenIntervalSeconds;  //!< in seconds, 10 mins
   double        m_averageBlockGenIntervalSeconds;      //!< the new m_averageBlockGenInterval we set
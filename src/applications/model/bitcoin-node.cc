@@ -18,6 +18,7 @@
 #include "ns3/tcp-socket-factory.h"
 #include "ns3/uinteger.h"
 #include "ns3/double.h"
+#include "ns3/enum.h"
 #include "bitcoin-node.h"
 
 namespace ns3 {
@@ -26,6 +27,148 @@ NS_LOG_COMPONENT_DEFINE ("BitcoinNode");
 
 NS_OBJECT_ENSURE_REGISTERED (BitcoinNode);
 
+
+/**
+ * Adds the fullBlock flag and the available chunks (if the block is not full) to an announced block
+ * and returns the number of the available chunks.
+ */
+static long
+AddAvailableChunks (rapidjson::Value &blockInfo, const std::vector<int> *availableChunks, rapidjson::Document &d)
+{
+  rapidjson::Value value;
+
+  if (availableChunks == nullptr)
+  {
+    value = true;
+    blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
+    return 0;
+  }
+
+  rapidjson::Value chunkArray(rapidjson::kArrayType);
+
+  value = false;
+  blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
+
+  for (auto &chunk : *availableChunks)
+  {
+    value = chunk;
+    chunkArray.PushBack(value, d.GetAllocator());
+  }
+  blockInfo.AddMember("availableChunks", chunkArray, d.GetAllocator ());
+  return availableChunks->size();
+}
+
+
+/**
+ * Compile-time policies of the block announcements. Each instantiation builds the announcement of one protocol type,
+ * with or without the blockTorrent fields, and knows the statistic that counts its Bytes. There are no runtime
+ * protocol branches inside the per-block loops; the branches on blockTorrent are on a template parameter.
+ */
+template <enum ProtocolType protocolType, bool blockTorrent>
+struct AnnouncementPolicy;
+
+template <bool blockTorrent>
+struct AnnouncementPolicy<STANDARD_PROTOCOL, blockTorrent>
+{
+  static long
+  Build (rapidjson::Document &d, const std::vector<Block> &blocks, const std::vector<int> *availableChunks)
+  {
+    rapidjson::Value value;
+    rapidjson::Value array(rapidjson::kArrayType);
+    long             bytes = ProtocolProfile::bitcoinMessageHeader + ProtocolProfile::countBytes;
+
+    value = blockTorrent ? EXT_INV : INV;
+    d.AddMember("message", value, d.GetAllocator());
+
+    for (auto &block : blocks)
+    {
+      std::ostringstream stringStream;
+      std::string        blockHash;
+
+      stringStream << block.GetBlockHeight () << "/" << block.GetMinerId ();
+      blockHash = stringStream.str();
+      value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
+      bytes += ProtocolProfile::inventorySizeBytes;
+
+      if (!blockTorrent)
+        array.PushBack(value, d.GetAllocator());
+      else
+      {
+        rapidjson::Value blockInfo(rapidjson::kObjectType);
+
+        blockInfo.AddMember("hash", value, d.GetAllocator ());
+
+        value = block.GetBlockSizeBytes ();
+        blockInfo.AddMember("size", value, d.GetAllocator ());
+
+        bytes += 5 + AddAvailableChunks (blockInfo, availableChunks, d); //1Byte(fullBlock) + 4Bytes(numberOfChunks)
+        array.PushBack(blockInfo, d.GetAllocator());
+      }
+    }
+    d.AddMember("inv", array, d.GetAllocator());
+    return bytes;
+  }
+
+  static long nodeStatistics::*
+  GetSentBytes (void)
+  {
+    return blockTorrent ? &nodeStatistics::extInvSentBytes : &nodeStatistics::invSentBytes;
+  }
+};
+
+template <bool blockTorrent>
+struct AnnouncementPolicy<SENDHEADERS, blockTorrent>
+{
+  static long
+  Build (rapidjson::Document &d, const std::vector<Block> &blocks, const std::vector<int> *availableChunks)
+  {
+    rapidjson::Value value;
+    rapidjson::Value array(rapidjson::kArrayType);
+    long             bytes = ProtocolProfile::bitcoinMessageHeader + ProtocolProfile::countBytes;
+
+    value = blockTorrent ? EXT_HEADERS : HEADERS;
+    d.AddMember("message", value, d.GetAllocator());
+
+    for (auto &block : blocks)
+    {
+      rapidjson::Value blockInfo(rapidjson::kObjectType);
+
+      value = block.GetBlockHeight ();
+      blockInfo.AddMember("height", value, d.GetAllocator ());
+
+      value = block.GetMinerId ();
+      blockInfo.AddMember("minerId", value, d.GetAllocator ());
+
+      value = block.GetParentBlockMinerId ();
+      blockInfo.AddMember("parentBlockMinerId", value, d.GetAllocator ());
+
+      value = block.GetBlockSizeBytes ();
+      blockInfo.AddMember("size", value, d.GetAllocator ());
+
+      value = block.GetTimeCreated ();
+      blockInfo.AddMember("timeCreated", value, d.GetAllocator ());
+
+      value = block.GetTimeReceived ();
+      blockInfo.AddMember("timeReceived", value, d.GetAllocator ());
+
+      bytes += ProtocolProfile::headersSizeBytes;
+      if (blockTorrent)
+        bytes += 1 + AddAvailableChunks (blockInfo, availableChunks, d); //fullBlock
+
+      array.PushBack(blockInfo, d.GetAllocator());
+    }
+    d.AddMember("blocks", array, d.GetAllocator());
+    return bytes;
+  }
+
+  static long nodeStatistics::*
+  GetSentBytes (void)
+  {
+    return blockTorrent ? &nodeStatistics::extHeadersSentBytes : &nodeStatistics::headersSentBytes;
+  }
+};
+
+
 TypeId 
 BitcoinNode::GetTypeId (void)
 {
@@ -63,17 +206,93 @@ BitcoinNode::GetTypeId (void)
                    UintegerValue (100000),
                    MakeUintegerAccessor (&BitcoinNode::m_chunkSize),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("TimeoutTickInterval", 
+				   "The granularity of the block and chunk timeouts",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&BitcoinNode::m_timeoutTickInterval),
+                   MakeTimeChecker())
+    .AddAttribute ("TrickleInv",
+                   "Batch the block announcements per peer and send them on a Poisson timer",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BitcoinNode::m_trickleInv),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TrickleMeanInterval", 
+				   "The mean interval between two consecutive announcements to the same peer, when TrickleInv is enabled",
+                   TimeValue (Seconds (2)),
+                   MakeTimeAccessor (&BitcoinNode::m_trickleMeanInterval),
+                   MakeTimeChecker())
+    .AddAttribute ("MaxOrphans", 
+				   "The maximum number of orphan blocks kept until their parent is received (0 for unlimited)",
+                   UintegerValue (750),
+                   MakeUintegerAccessor (&BitcoinNode::m_maxOrphans),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("OrphanEvictionPolicy", 
+				   "The orphan block that is evicted when MaxOrphans is reached",
+                   EnumValue (EVICT_OLDEST),
+                   MakeEnumAccessor (&BitcoinNode::m_orphanEvictionPolicy),
+                   MakeEnumChecker (EVICT_OLDEST, "Oldest",
+                                    EVICT_NEWEST, "Newest"))
+    .AddAttribute ("PruneDepth", 
+				   "The number of heights kept below the top block; deeper heights are pruned (0 disables pruning)",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&BitcoinNode::m_pruneDepth),
+                   MakeUintegerChecker<uint32_t> ())
     .AddTraceSource ("Rx",
                      "A packet has been received",
                      MakeTraceSourceAccessor (&BitcoinNode::m_rxTrace),
                      "ns3::Packet::AddressTracedCallback")
+    .AddTraceSource ("BlockMined",
+                     "A miner generated a new block",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_blockMinedTrace),
+                     "ns3::BitcoinNode::BlockTracedCallback")
+    .AddTraceSource ("BlockReceived",
+                     "A full block, or the last chunk of a block, has been received",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_blockReceivedTrace),
+                     "ns3::BitcoinNode::BlockTracedCallback")
+    .AddTraceSource ("BlockValidated",
+                     "A block has been validated and added to the blockchain",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_blockValidatedTrace),
+                     "ns3::BitcoinNode::BlockTracedCallback")
+    .AddTraceSource ("OrphanAdded",
+                     "A block whose parent is unknown has been added to the orphan pool",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_orphanAddedTrace),
+                     "ns3::BitcoinNode::BlockTracedCallback")
+    .AddTraceSource ("TimeoutFired",
+                     "The timeout of a requested block or chunk has expired",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_timeoutFiredTrace),
+                     "ns3::BitcoinNode::TimeoutTracedCallback")
+    .AddTraceSource ("ChunkReceived",
+                     "A chunk has been received",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_chunkReceivedTrace),
+                     "ns3::BitcoinNode::ChunkTracedCallback")
+    .AddTraceSource ("MessageSent",
+                     "A message has been sent to a peer",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_messageSentTrace),
+                     "ns3::BitcoinNode::MessageTracedCallback")
+    .AddTraceSource ("BlockHop",
+                     "A requested block has been validated, with the delays of its propagation hop",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_blockHopTrace),
+                     "ns3::BitcoinNode::HopTracedCallback")
+    .AddTraceSource ("ChainReorg",
+                     "The top block has been replaced by a block which does not extend it",
+                     MakeTraceSourceAccessor (&BitcoinNode::m_chainReorgTrace),
+                     "ns3::BitcoinNode::ReorgTracedCallback")
   ;
   return tid;
 }
 
-BitcoinNode::BitcoinNode (void) : m_bitcoinPort (8333), m_secondsPerMin(60), m_isMiner (false), m_countBytes (4), m_bitcoinMessageHeader (90),
-                                  m_inventorySizeBytes (36), m_getHeadersSizeBytes (72), m_headersSizeBytes (81), m_blockHeadersSizeBytes (81),
-                                  m_averageTransactionSize (522.4), m_transactionIndexSize (2)
+constexpr int BitcoinNode::m_bitcoinPort;
+constexpr int BitcoinNode::m_secondsPerMin;
+constexpr int BitcoinNode::m_countBytes;
+constexpr int BitcoinNode::m_bitcoinMessageHeader;
+constexpr int BitcoinNode::m_inventorySizeBytes;
+constexpr int BitcoinNode::m_getHeadersSizeBytes;
+constexpr int BitcoinNode::m_headersSizeBytes;
+constexpr int BitcoinNode::m_blockHeadersSizeBytes;
+constexpr double BitcoinNode::m_averageTransactionSize;
+constexpr int BitcoinNode::m_transactionIndexSize;
+
+BitcoinNode::BitcoinNode (void) : m_isMiner (false), m_buildAnnouncement (nullptr), m_announcementSentBytes (nullptr)
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
@@ -82,7 +301,7 @@ BitcoinNode::BitcoinNode (void) : m_bitcoinPort (8333), m_secondsPerMin(60), m_i
   m_meanBlockPropagationTime = 0;
   m_meanBlockSize = 0;
   m_numberOfPeers = m_peersAddresses.size();
-  
+  m_trickleIntervals = CreateObject<ExponentialRandomVariable> ();
 }
 
 BitcoinNode::~BitcoinNode(void)
@@ -102,7 +321,7 @@ std::vector<Ipv4Address>
 BitcoinNode::GetPeersAddresses (void) const
 {
   NS_LOG_FUNCTION (this);
-  return m_peersAddresses;
+  return std::vector<Ipv4Address> (m_peersAddresses.begin(), m_peersAddresses.end());
 }
 
 
@@ -110,8 +329,49 @@ void
 BitcoinNode::SetPeersAddresses (const std::vector<Ipv4Address> &peers)
 {
   NS_LOG_FUNCTION (this);
+  m_topology = 0;
+  m_ownedPeersAddresses = peers;
+  ResetPeers (m_ownedPeersAddresses);
+}
+
+
+void 
+BitcoinNode::SetTopology (Ptr<const BitcoinTopology> topology, uint32_t nodeId)
+{
+  NS_LOG_FUNCTION (this);
+
+  Span<double> peersDownloadSpeeds = topology->GetPeersDownloadSpeeds (nodeId);
+  Span<double> peersUploadSpeeds = topology->GetPeersUploadSpeeds (nodeId);
+
+  m_topology = topology;
+  m_ownedPeersAddresses.clear();
+  ResetPeers (m_topology->GetPeersAddresses (nodeId));
+
+  std::copy (peersDownloadSpeeds.begin(), peersDownloadSpeeds.end(), m_peerDownloadSpeeds.begin());
+  std::copy (peersUploadSpeeds.begin(), peersUploadSpeeds.end(), m_peerUploadSpeeds.begin());
+  SetNodeInternetSpeeds (m_topology->GetNodeInternetSpeeds (nodeId));
+}
+
+
+void 
+BitcoinNode::ResetPeers (Span<Ipv4Address> peers)
+{
   m_peersAddresses = peers;
   m_numberOfPeers = m_peersAddresses.size();
+
+  /**
+   * The peers get the dense indices 0..m_numberOfPeers - 1 in the order of m_peersAddresses
+   */
+  m_peerIndex.clear();
+  m_peerSockets.clear();
+  m_peerDownloadSpeeds.clear();
+  m_peerUploadSpeeds.clear();
+  m_peerBufferedData.clear();
+  m_peerPendingInv.clear();
+  m_peerTrickleEvents.clear();
+
+  for (auto &peer : m_peersAddresses)
+    GetPeerIndex (peer);
 }
 
 
@@ -119,7 +379,9 @@ void
 BitcoinNode::SetPeersDownloadSpeeds (const std::map<Ipv4Address, double> &peersDownloadSpeeds)
 {
   NS_LOG_FUNCTION (this);
-  m_peersDownloadSpeeds = peersDownloadSpeeds;
+
+  for (auto &speed : peersDownloadSpeeds)
+    m_peerDownloadSpeeds[GetPeerIndex (speed.first)] = speed.second;
 }
 
 
@@ -127,7 +389,33 @@ void
 BitcoinNode::SetPeersUploadSpeeds (const std::map<Ipv4Address, double> &peersUploadSpeeds)
 {
   NS_LOG_FUNCTION (this);
-  m_peersUploadSpeeds = peersUploadSpeeds;
+
+  for (auto &speed : peersUploadSpeeds)
+    m_peerUploadSpeeds[GetPeerIndex (speed.first)] = speed.second;
+}
+
+
+uint32_t 
+BitcoinNode::GetPeerIndex (Ipv4Address address)
+{
+  auto it = m_peerIndex.find (address);
+
+  if (it != m_peerIndex.end ())
+    return it->second;
+
+  /**
+   * A new address (e.g. a node that is not a peer but sent us a message) gets the next free index
+   */
+  uint32_t index = m_peerSockets.size ();
+
+  m_peerIndex[address] = index;
+  m_peerSockets.push_back (Ptr<Socket> ());
+  m_peerDownloadSpeeds.push_back (0);
+  m_peerUploadSpeeds.push_back (0);
+  m_peerBufferedData.push_back (std::string ());
+  m_peerPendingInv.push_back (std::vector<Block> ());
+  m_peerTrickleEvents.push_back (EventId ());
+  return index;
 }
 
 void 
@@ -147,6 +435,20 @@ BitcoinNode::SetNodeStats (nodeStatistics *nodeStats)
   m_nodeStats = nodeStats;
 }
 
+nodeStatistics* 
+BitcoinNode::GetNodeStats (void) const
+{
+  return m_nodeStats;
+}
+
+int64_t
+BitcoinNode::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_trickleIntervals->SetStream (stream);
+  return 1;
+}
+
 void 
 BitcoinNode::SetProtocolType (enum ProtocolType protocolType)
 {
@@ -159,6 +461,7 @@ BitcoinNode::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
+  m_trickleIntervals = 0;
 
   // chain up
   Application::DoDispose ();
@@ -180,6 +483,18 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
   NS_LOG_WARN ("Node " << GetNode()->GetId() << ": m_protocolType = " << getProtocolType(m_protocolType));
   NS_LOG_WARN ("Node " << GetNode()->GetId() << ": m_blockTorrent = " << m_blockTorrent);
   NS_LOG_WARN ("Node " << GetNode()->GetId() << ": m_chunkSize = " << m_chunkSize << " Bytes");
+  NS_LOG_WARN ("Node " << GetNode()->GetId() << ": m_trickleInv = " << m_trickleInv);
+
+  SelectAnnouncementPolicy ();
+  m_blockchain.SetOrphanPoolLimits (m_maxOrphans, m_orphanEvictionPolicy);
+  m_blockchain.SetPruneDepth (m_pruneDepth);
+
+  if (m_trickleInv)
+  {
+    if (m_trickleMeanInterval.GetSeconds () <= 0)
+      NS_FATAL_ERROR ("TrickleMeanInterval must be positive, not " << m_trickleMeanInterval.GetSeconds () << "s");
+    NS_LOG_INFO ("Node " << GetNode()->GetId() << ": m_trickleMeanInterval = " << m_trickleMeanInterval.GetSeconds() << "s");
+  }
 
   NS_LOG_INFO ("Node " << GetNode()->GetId() << ": My peers are");
   
@@ -188,9 +503,9 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
 
   double currentMax = 0;
   
-  for(auto it = m_peersDownloadSpeeds.begin(); it != m_peersDownloadSpeeds.end(); ++it ) 
+  for(uint32_t i = 0; i < m_peersAddresses.size(); ++i) 
   {
-    //std::cout << "Node " << GetNode()->GetId() << ": peer " << it->first << "download speed = " << it->second << " Mbps" << std::endl;
+    //std::cout << "Node " << GetNode()->GetId() << ": peer " << m_peersAddresses[i] << "download speed = " << m_peerDownloadSpeeds[i] << " Mbps" << std::endl;
   }
   
   if (!m_socket)
@@ -223,10 +538,10 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
     MakeCallback (&BitcoinNode::HandlePeerError, this));
 	
   NS_LOG_DEBUG ("Node " << GetNode()->GetId() << ": Before creating sockets");
-  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+  for (uint32_t i = 0; i < m_peersAddresses.size(); ++i)
   {
-    m_peersSockets[*i] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
-    m_peersSockets[*i]->Connect (InetSocketAddress (*i, m_bitcoinPort));
+    m_peerSockets[i] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
+    m_peerSockets[i]->Connect (InetSocketAddress (m_peersAddresses[i], m_bitcoinPort));
   }
   NS_LOG_DEBUG ("Node " << GetNode()->GetId() << ": After creating sockets");
 
@@ -268,6 +583,13 @@ BitcoinNode::StartApplication ()    // Called at time specified by Start
   m_nodeStats->blockTimeouts = 0;
   m_nodeStats->chunkTimeouts = 0;
   m_nodeStats->minedBlocksInMainChain = 0;
+  m_nodeStats->orphansResolved = 0;
+  m_nodeStats->orphansEvicted = 0;
+  m_nodeStats->processedEvents = 0;
+  m_nodeStats->processingTime = 0;
+  m_nodeStats->propagationHops = 0;
+  for (int i = 0; i < NO_HOP_DELAYS; i++)
+    m_nodeStats->meanHopDelays[i] = 0;
 }
 
 void 
@@ -275,9 +597,9 @@ BitcoinNode::StopApplication ()     // Called at time specified by Stop
 {
   NS_LOG_FUNCTION (this);
 
-  for (std::vector<Ipv4Address>::iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i) //close the outgoing sockets
+  for (uint32_t i = 0; i < m_peersAddresses.size(); ++i) //close the outgoing sockets
   {
-    m_peersSockets[*i]->Close ();
+    m_peerSockets[i]->Close ();
   }
   
 
@@ -287,6 +609,14 @@ BitcoinNode::StopApplication ()     // Called at time specified by Stop
     m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
   }
 
+  EventCensus::Cancel (TIMEOUT_TICK_EVENT, m_timeoutTickEvent);
+
+  for (uint32_t i = 0; i < m_peerTrickleEvents.size(); ++i)
+  {
+    EventCensus::Cancel (FLUSH_PENDING_INV_EVENT, m_peerTrickleEvents[i]);
+    m_peerPendingInv[i].clear();
+  }
+
   NS_LOG_WARN ("\n\nBITCOIN NODE " << GetNode ()->GetId () << ":");
   NS_LOG_WARN ("Current Top Block is:\n" << *(m_blockchain.GetCurrentTopBlock()));
   NS_LOG_WARN ("Current Blockchain is:\n" << m_blockchain);
@@ -307,6 +637,8 @@ BitcoinNode::StopApplication ()     // Called at time specified by Stop
   NS_LOG_WARN("m_receiveBlockTimes size = " << m_receiveBlockTimes.size());
   NS_LOG_WARN("longest fork = " << m_blockchain.GetLongestForkSize());
   NS_LOG_WARN("blocks in forks = " << m_blockchain.GetBlocksInForks());
+  NS_LOG_WARN("orphans = " << m_blockchain.GetNoOrphans() << ", resolved = " << m_blockchain.GetOrphansResolved()
+              << ", evicted = " << m_blockchain.GetOrphansEvicted());
   
   m_nodeStats->meanBlockReceiveTime = m_meanBlockReceiveTime;
   m_nodeStats->meanBlockPropagationTime = m_meanBlockPropagationTime;
@@ -315,6 +647,8 @@ BitcoinNode::StopApplication ()     // Called at time specified by Stop
   m_nodeStats->staleBlocks = m_blockchain.GetNoStaleBlocks();
   m_nodeStats->longestFork = m_blockchain.GetLongestForkSize();
   m_nodeStats->blocksInForks = m_blockchain.GetBlocksInForks();
+  m_nodeStats->orphansResolved = m_blockchain.GetOrphansResolved();
+  m_nodeStats->orphansEvicted = m_blockchain.GetOrphansEvicted();
 
 }
 
@@ -325,6 +659,13 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
   Ptr<Packet> packet;
   Address from;
   double newBlockReceiveTime = Simulator::Now ().GetSeconds();
+  std::chrono::steady_clock::time_point handleStart;
+
+  /**
+   * Socket reads are not scheduled through the EventCensus, so their load is recorded here
+   */
+  if (EventCensus::IsLoadProfileEnabled ())
+    handleStart = std::chrono::steady_clock::now ();
 
   while ((packet = socket->RecvFrom (from)))
   {
@@ -344,6 +685,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
         size_t pos = 0;
         char *packetInfo = new char[packet->GetSize () + 1];
         std::ostringstream totalStream;
+        uint32_t peerIndex = GetPeerIndex (InetSocketAddress::ConvertFrom(from).GetIpv4 ());
 		
         packet->CopyData (reinterpret_cast<uint8_t*>(packetInfo), packet->GetSize ());
         packetInfo[packet->GetSize ()] = '\0'; // ensure that it is null terminated to avoid bugs
@@ -351,7 +693,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
         /**
          * Add the buffered data to complete the packet
          */
-        totalStream << m_bufferedData[from] << packetInfo; 
+        totalStream << m_peerBufferedData[peerIndex] << packetInfo; 
         std::string totalReceivedData(totalStream.str());
         NS_LOG_INFO("Node " << GetNode ()->GetId () << " Total Received Data: " << totalReceivedData);
 		  
@@ -370,17 +712,14 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
             continue;
           }			
 		  
-          rapidjson::StringBuffer buffer;
-          rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-          d.Accept(writer);
-		  
           NS_LOG_INFO ("At time "  << Simulator::Now ().GetSeconds ()
                         << "s bitcoin node " << GetNode ()->GetId () << " received "
                         <<  packet->GetSize () << " bytes from "
                         << InetSocketAddress::ConvertFrom(from).GetIpv4 ()
                         << " port " << InetSocketAddress::ConvertFrom (from).GetPort () 
-                        << " with info = " << buffer.GetString());	
+                        << " with info = " << parsedPacket);	
 						
+          BITCOIN_PROFILE_HANDLER (d["message"].GetInt());
           switch (d["message"].GetInt())
           {
             case INV:
@@ -397,7 +736,6 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 std::string   invDelimiter = "/";
                 std::string   parsedInv = d["inv"][j].GetString();
                 size_t        invPos = parsedInv.find(invDelimiter);
-                EventId       timeout;
 
                 int height = atoi(parsedInv.substr(0, invPos).c_str());
                 int minerId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
@@ -419,13 +757,13 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                    * Check if we have already requested the block
                    */
 				   
-                  if (m_invTimeouts.find(parsedInv) == m_invTimeouts.end())
+                  if (!m_invTimeouts.IsArmed(parsedInv))
                   {
                     NS_LOG_INFO("INV: Bitcoin node " << GetNode ()->GetId ()
                                  << " has not requested the block yet");
                     requestBlocks.push_back(parsedInv);
-                    timeout = Simulator::Schedule (m_invTimeoutMinutes, &BitcoinNode::InvTimeoutExpired, this, parsedInv);
-                    m_invTimeouts[parsedInv] = timeout;
+                    ArmInvTimeout (parsedInv, m_invTimeoutMinutes);
+                    RecordBlockRequest (parsedInv, InetSocketAddress::ConvertFrom(from).GetIpv4 ());
                   }
                   else
                   {
@@ -476,7 +814,6 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 std::string   blockHash = d["inv"][j]["hash"].GetString();
                 int           blockSize = d["inv"][j]["size"].GetInt();
                 size_t        invPos = blockHash.find(invDelimiter);
-                EventId       timeout;
 
                 int height = atoi(blockHash.substr(0, invPos).c_str());
                 int minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
@@ -555,10 +892,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                       chunk << blockHash << "/" << candidateChunks[randomIndex];
                       requestChunks.push_back(chunk.str());
 					  
-                      timeout = Simulator::Schedule (Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))),
-                                                     &BitcoinNode::ChunkTimeoutExpired, this, chunk.str());
-													 
-                      m_chunkTimeouts[chunk.str()] = timeout;
+                      ArmChunkTimeout (chunk.str(), Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))));
                       m_queueChunkPeers[blockHash].push_back(from);
                     }
                     else
@@ -928,6 +1262,14 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                   value = block_it->GetTimeReceived ();							
                   blockInfo.AddMember("timeReceived", value, d.GetAllocator ());
 				  
+                  /**
+                   * The blocks mined by this node were never validated, they were available as soon as they were created
+                   */
+                  std::unordered_map<BlockId, double, BlockIdHash>::const_iterator validated = 
+                    m_blockValidationTimes.find (BlockId (block_it->GetBlockHeight (), block_it->GetMinerId ()));
+                  value = validated != m_blockValidationTimes.end () ? validated->second : block_it->GetTimeReceived ();
+                  blockInfo.AddMember("timeValidated", value, d.GetAllocator ());
+				  
                   array.PushBack(blockInfo, d.GetAllocator());
                 }	
 				
@@ -937,7 +1279,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
 	            double eventTime;	
 				
 /*                 std::cout << "Node " << GetNode()->GetId() << "-" << InetSocketAddress::ConvertFrom(from).GetIpv4 () 
-		  		          << " " << m_peersDownloadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4 ()] << " Mbps , time = "
+		  		          << " " << m_peerDownloadSpeeds[GetPeerIndex (InetSocketAddress::ConvertFrom(from).GetIpv4 ())] << " Mbps , time = "
 		  		          << Simulator::Now ().GetSeconds() << "s \n"; */
                 
                 if (m_sendBlockTimes.size() == 0 || Simulator::Now ().GetSeconds() >  m_sendBlockTimes.back())
@@ -951,6 +1293,15 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 }
                 m_sendBlockTimes.push_back(Simulator::Now ().GetSeconds() + eventTime + sendTime);
  
+                /**
+                 * The receiver decomposes the propagation hop of the blocks with these
+                 */
+                for (j=0; j<d["blocks"].Size(); j++)
+                {
+                  value = eventTime;
+                  d["blocks"][j].AddMember("uploadQueueing", value, d.GetAllocator ());
+                }
+
                 //std::cout << sendTime << " " << eventTime << " " << m_sendBlockTimes.size() << std::endl;
                 NS_LOG_INFO("Node " << GetNode()->GetId() << " will start sending the block to " << InetSocketAddress::ConvertFrom(from).GetIpv4 () 
                             << " at " << Simulator::Now ().GetSeconds() + eventTime << "\n");
@@ -963,8 +1314,8 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 std::string packet = packetInfo.GetString();
                 NS_LOG_INFO ("DEBUG: " << packetInfo.GetString());
 				
-                Simulator::Schedule (Seconds(eventTime), &BitcoinNode::SendBlock, this, packet, from);
-                Simulator::Schedule (Seconds(eventTime + sendTime), &BitcoinNode::RemoveSendTime, this);
+                EventCensus::Schedule (SEND_BLOCK_EVENT, Seconds(eventTime), &BitcoinNode::SendBlock, this, packet, from);
+                EventCensus::Schedule (REMOVE_SEND_TIME_EVENT, Seconds(eventTime + sendTime), &BitcoinNode::RemoveSendTime, this);
 
               }
               break;
@@ -1050,7 +1401,6 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
 
                 if (candidateChunks.size() > 0)
                 {
-                  EventId              timeout;
                   int randomIndex = rand() % candidateChunks.size();
 				  
                   NS_LOG_INFO("EXT_GET_DATA: Bitcoin node " << GetNode ()->GetId ()
@@ -1067,10 +1417,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                   if (blockSize == -1)
                     NS_FATAL_ERROR ("blockSize == -1");
 				
-                  timeout = Simulator::Schedule (Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))),
-                                                     &BitcoinNode::ChunkTimeoutExpired, this, chunk.str());
-
-                  m_chunkTimeouts[chunk.str()] = timeout;
+                  ArmChunkTimeout (chunk.str(), Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))));
                   m_queueChunkPeers[blockHash].push_back(from);
                 }
                 else
@@ -1205,7 +1552,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 double eventTime;
 				
 /*                 std::cout << "Node " << GetNode()->GetId() << "-" << InetSocketAddress::ConvertFrom(from).GetIpv4 () 
-		  		          << " " << m_peersDownloadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4 ()] << " Mbps , time = "
+		  		          << " " << m_peerDownloadSpeeds[GetPeerIndex (InetSocketAddress::ConvertFrom(from).GetIpv4 ())] << " Mbps , time = "
 		  		          << Simulator::Now ().GetSeconds() << "s \n"; */
                 
                 if (m_sendBlockTimes.size() == 0 || Simulator::Now ().GetSeconds() >  m_sendBlockTimes.back())
@@ -1231,8 +1578,8 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 std::string packet = packetInfo.GetString();
                 NS_LOG_INFO ("DEBUG: " << packetInfo.GetString());
 				
-                Simulator::Schedule (Seconds(eventTime), &BitcoinNode::SendChunk, this, packet, from);
-                Simulator::Schedule (Seconds(eventTime + sendTime), &BitcoinNode::RemoveSendTime, this);
+                EventCensus::Schedule (SEND_CHUNK_EVENT, Seconds(eventTime), &BitcoinNode::SendChunk, this, packet, from);
+                EventCensus::Schedule (REMOVE_SEND_TIME_EVENT, Seconds(eventTime + sendTime), &BitcoinNode::RemoveSendTime, this);
               }
               break;
             }
@@ -1256,7 +1603,6 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 int minerId = d["blocks"][j]["minerId"].GetInt();
 				
 				
-                EventId              timeout;
                 std::ostringstream   stringStream;  
                 std::string          blockHash;
                 std::string          parentBlockHash ;
@@ -1286,13 +1632,13 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                    * Acquire block
                    */
 	  
-                  if (m_invTimeouts.find(blockHash) == m_invTimeouts.end())
+                  if (!m_invTimeouts.IsArmed(blockHash))
                   {
                     NS_LOG_INFO("HEADERS: Bitcoin node " << GetNode ()->GetId ()
                                  << " has not requested the block yet");
                     requestBlocks.push_back(blockHash.c_str());
-                    timeout = Simulator::Schedule (m_invTimeoutMinutes, &BitcoinNode::InvTimeoutExpired, this, blockHash);
-                    m_invTimeouts[blockHash] = timeout;
+                    ArmInvTimeout (blockHash, m_invTimeoutMinutes);
+                    RecordBlockRequest (blockHash, InetSocketAddress::ConvertFrom(from).GetIpv4 ());
                   }
                   else
                   {
@@ -1315,7 +1661,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                    * Acquire parent
                    */
 	  
-                  if (m_invTimeouts.find(parentBlockHash) == m_invTimeouts.end())
+                  if (!m_invTimeouts.IsArmed(parentBlockHash))
                   {
                     NS_LOG_INFO("HEADERS: Bitcoin node " << GetNode ()->GetId ()
                                  << " has not requested its parent block yet");
@@ -1324,9 +1670,11 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                       (m_protocolType == SENDHEADERS && std::find(requestBlocks.begin(), requestBlocks.end(), parentBlockHash) == requestBlocks.end()))
                     {
                       if (!OnlyHeadersReceived(parentBlockHash))
+                      {
                         requestHeaders.push_back(parentBlockHash.c_str());
-                      timeout = Simulator::Schedule (m_invTimeoutMinutes, &BitcoinNode::InvTimeoutExpired, this, parentBlockHash);
-                      m_invTimeouts[parentBlockHash] = timeout;
+                        RecordBlockRequest (parentBlockHash, InetSocketAddress::ConvertFrom(from).GetIpv4 ());
+                      }
+                      ArmInvTimeout (parentBlockHash, m_invTimeoutMinutes);
                     }
                   }
                   else
@@ -1416,7 +1764,6 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 int blockSize = d["blocks"][j]["size"].GetInt();
 
 				
-                EventId              timeout;
                 std::ostringstream   stringStream;  
                 std::string          blockHash;
                 std::string          parentBlockHash ;
@@ -1507,10 +1854,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                       chunk << blockHash << "/" << candidateChunks[randomIndex];
                       requestChunks.push_back(chunk.str());
 					  
-                      timeout = Simulator::Schedule (Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))),
-                                                     &BitcoinNode::ChunkTimeoutExpired, this, chunk.str());
-													 
-                      m_chunkTimeouts[chunk.str()] = timeout;
+                      ArmChunkTimeout (chunk.str(), Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(blockSize/static_cast<double>(m_chunkSize))));
                       m_queueChunkPeers[blockHash].push_back(from);
                     }
                     else
@@ -1673,7 +2017,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
               int blockMessageSize = 0;
               double receiveTime = 0;
               double eventTime = 0;
-              double minSpeed = std::min(m_downloadSpeed, m_peersUploadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4 ()] * 1000000 / 8);
+              double minSpeed = std::min(m_downloadSpeed, m_peerUploadSpeeds[peerIndex] * 1000000 / 8);
 			  
               std::string blockType = d["type"].GetString();
 			  
@@ -1701,7 +2045,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
   
               NS_LOG_INFO("BLOCK: At time " << Simulator::Now ().GetSeconds () 
                           << " Node " << GetNode()->GetId() << " received a block message " << blockInfo.GetString());
-              NS_LOG_INFO(m_downloadSpeed << " " << m_peersUploadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4 ()] * 1000000 / 8 << " " << minSpeed);
+              NS_LOG_INFO(m_downloadSpeed << " " << m_peerUploadSpeeds[peerIndex] * 1000000 / 8 << " " << minSpeed);
 			  
               std::string help = blockInfo.GetString();
 			  
@@ -1720,8 +2064,8 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 m_receiveBlockTimes.push_back(Simulator::Now ().GetSeconds() + receiveTime);
 			  
 
-                Simulator::Schedule (Seconds(eventTime), &BitcoinNode::ReceivedBlockMessage, this, help, from);
-                Simulator::Schedule (Seconds(receiveTime), &BitcoinNode::RemoveReceiveTime, this);
+                EventCensus::Schedule (RECEIVED_BLOCK_MESSAGE_EVENT, Seconds(eventTime), &BitcoinNode::ReceivedBlockMessage, this, help, from);
+                EventCensus::Schedule (REMOVE_RECEIVE_TIME_EVENT, Seconds(receiveTime), &BitcoinNode::RemoveReceiveTime, this);
               }
               else if (blockType == "compressed-block")
               {
@@ -1738,10 +2082,11 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
                 m_receiveCompressedBlockTimes.push_back(Simulator::Now ().GetSeconds() + receiveTime);
 			  
 
-                Simulator::Schedule (Seconds(eventTime), &BitcoinNode::ReceivedBlockMessage, this, help, from);
-                Simulator::Schedule (Seconds(receiveTime), &BitcoinNode::RemoveCompressedBlockReceiveTime, this);
+                EventCensus::Schedule (RECEIVED_BLOCK_MESSAGE_EVENT, Seconds(eventTime), &BitcoinNode::ReceivedBlockMessage, this, help, from);
+                EventCensus::Schedule (REMOVE_COMPRESSED_BLOCK_RECEIVE_TIME_EVENT, Seconds(receiveTime), &BitcoinNode::RemoveCompressedBlockReceiveTime, this);
               }
 			  
+              RecordBlockMessage (d["blocks"], InetSocketAddress::ConvertFrom(from).GetIpv4 (), blockMessageSize / minSpeed, eventTime - blockMessageSize / minSpeed);
               NS_LOG_INFO("BLOCK:  Node " << GetNode()->GetId() << " will receive the full block message at " << Simulator::Now ().GetSeconds() + eventTime);
 
               break;
@@ -1752,7 +2097,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
               int chunkMessageSize = 0;
               double receiveTime = 0;
               double eventTime = 0;
-              double minSpeed = std::min(m_downloadSpeed, m_peersUploadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4 ()] * 1000000 / 8);
+              double minSpeed = std::min(m_downloadSpeed, m_peerUploadSpeeds[peerIndex] * 1000000 / 8);
 
               chunkMessageSize += m_bitcoinMessageHeader;
               for (int j=0; j<d["chunks"].Size(); j++)
@@ -1793,8 +2138,8 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
               m_receiveBlockTimes.push_back(Simulator::Now ().GetSeconds() + receiveTime);
 			  
               NS_LOG_INFO("CHUNK:  Node " << GetNode()->GetId() << " will receive the full chunk message at " << Simulator::Now ().GetSeconds() + eventTime);
-              Simulator::Schedule (Seconds(eventTime), &BitcoinNode::ReceivedChunkMessage, this, help, from);
-              Simulator::Schedule (Seconds(receiveTime), &BitcoinNode::RemoveReceiveTime, this);
+              EventCensus::Schedule (RECEIVED_CHUNK_MESSAGE_EVENT, Seconds(eventTime), &BitcoinNode::ReceivedChunkMessage, this, help, from);
+              EventCensus::Schedule (REMOVE_RECEIVE_TIME_EVENT, Seconds(receiveTime), &BitcoinNode::RemoveReceiveTime, this);
 
               break;
             }
@@ -1810,7 +2155,7 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
         * Buffer the remaining data
         */
 		 
-        m_bufferedData[from] = totalReceivedData;
+        m_peerBufferedData[peerIndex] = totalReceivedData;
         delete[] packetInfo;
       }
       else if (Inet6SocketAddress::IsMatchingType (from))
@@ -1823,6 +2168,8 @@ BitcoinNode::HandleRead (Ptr<Socket> socket)
       }
       m_rxTrace (packet, from);
   }
+  if (EventCensus::IsLoadProfileEnabled ())
+    EventCensus::RecordLoad (m_nodeStats, handleStart);
 }
 
 
@@ -1830,6 +2177,7 @@ void
 BitcoinNode::ReceivedBlockMessage(std::string &blockInfo, Address &from) 
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (RECEIVED_BLOCK_MESSAGE_HANDLER);
 
   rapidjson::Document d;
   d.Parse(blockInfo.c_str());
@@ -1847,7 +2195,6 @@ BitcoinNode::ReceivedBlockMessage(std::string &blockInfo, Address &from)
     int minerId = d["blocks"][j]["minerId"].GetInt();
 				
 
-    EventId              timeout;
     std::ostringstream   stringStream;  
     std::string          blockHash;
     std::string          parentBlockHash;
@@ -1878,8 +2225,8 @@ BitcoinNode::ReceivedBlockMessage(std::string &blockInfo, Address &from)
                  << " is an orphan, so it will be discarded\n");
 							   
       m_queueInv.erase(blockHash);
-      Simulator::Cancel (m_invTimeouts[blockHash]);
-      m_invTimeouts.erase(blockHash);
+      m_invTimeouts.Cancel(blockHash);
+      m_blockHops.erase(blockHash);
     }
     else
     {
@@ -1897,6 +2244,7 @@ void
 BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from) 
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (RECEIVED_CHUNK_MESSAGE_HANDLER);
   
   rapidjson::Document d;
   d.Parse(chunkInfo.c_str());
@@ -1917,8 +2265,11 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
     int height = d["chunks"][j]["height"].GetInt();
     int minerId = d["chunks"][j]["minerId"].GetInt();
     int chunkId = d["chunks"][j]["chunk"].GetInt();
+    chunkTrace trace = {static_cast<int> (GetNode ()->GetId ()), height, minerId, chunkId,
+                        InetSocketAddress::ConvertFrom(from).GetIpv4 ().Get ()};
+
+    m_chunkReceivedTrace (trace);
 
-    EventId              timeout;
     std::ostringstream   stringStream;  
     std::string          blockHash;
     std::string          chunkHash;
@@ -1948,10 +2299,9 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
     PrintReceivedChunks();
     PrintOnlyHeadersReceived(); */
 
-    if (m_chunkTimeouts.find(chunkHash) != m_chunkTimeouts.end())
+    if (m_chunkTimeouts.IsArmed(chunkHash))
     {
-      Simulator::Cancel (m_chunkTimeouts[chunkHash]);
-      m_chunkTimeouts.erase(chunkHash);
+      m_chunkTimeouts.Cancel(chunkHash);
     }
 
 	
@@ -2057,10 +2407,7 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
               }
             }
 					  
-            timeout = Simulator::Schedule (Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(d["chunks"][j]["size"].GetInt()/static_cast<double>(m_chunkSize))),
-                                                   &BitcoinNode::ChunkTimeoutExpired, this, chunk.str());
-													 
-            m_chunkTimeouts[chunk.str()] = timeout;
+            ArmChunkTimeout (chunk.str(), Minutes(m_invTimeoutMinutes.GetMinutes() / ceil(d["chunks"][j]["size"].GetInt()/static_cast<double>(m_chunkSize))));
             m_queueChunkPeers[blockHash].push_back(from);
           }
           else
@@ -2261,7 +2608,7 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
     double eventTime;
 				
 /*                 std::cout << "Node " << GetNode()->GetId() << "-" << InetSocketAddress::ConvertFrom(from).GetIpv4 () 
-		  		          << " " << m_peersDownloadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4 ()] << " Mbps , time = "
+		  		          << " " << m_peerDownloadSpeeds[GetPeerIndex (InetSocketAddress::ConvertFrom(from).GetIpv4 ())] << " Mbps , time = "
 		  		          << Simulator::Now ().GetSeconds() << "s \n"; */
                 
     if (m_sendBlockTimes.size() == 0 || Simulator::Now ().GetSeconds() >  m_sendBlockTimes.back())
@@ -2287,8 +2634,8 @@ BitcoinNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
     std::string packet = packetInfo.GetString();
     NS_LOG_INFO ("DEBUG: " << packetInfo.GetString());
 				
-    Simulator::Schedule (Seconds(eventTime), &BitcoinNode::SendChunk, this, packet, from); 
-    Simulator::Schedule (Seconds(eventTime + sendTime), &BitcoinNode::RemoveSendTime, this);
+    EventCensus::Schedule (SEND_CHUNK_EVENT, Seconds(eventTime), &BitcoinNode::SendChunk, this, packet, from); 
+    EventCensus::Schedule (REMOVE_SEND_TIME_EVENT, Seconds(eventTime + sendTime), &BitcoinNode::RemoveSendTime, this);
 
   }
 }
@@ -2300,6 +2647,7 @@ BitcoinNode::ReceiveBlock(const Block &newBlock)
   NS_LOG_FUNCTION (this);
   NS_LOG_INFO ("ReceiveBlock: At time " << Simulator::Now ().GetSeconds ()
                 << "s bitcoin node " << GetNode ()->GetId () << " received " << newBlock);
+  m_blockReceivedTrace (MakeBlockTrace (newBlock));
 
   std::ostringstream   stringStream;  
   std::string          blockHash = stringStream.str();
@@ -2311,11 +2659,10 @@ BitcoinNode::ReceiveBlock(const Block &newBlock)
   {
     NS_LOG_INFO ("ReceiveBlock: Bitcoin node " << GetNode ()->GetId () << " has already added this block in the m_blockchain: " << newBlock);
     
-    if (m_invTimeouts.find(blockHash) != m_invTimeouts.end())
+    if (m_invTimeouts.IsArmed(blockHash))
     {
       m_queueInv.erase(blockHash);
-      Simulator::Cancel (m_invTimeouts[blockHash]);
-      m_invTimeouts.erase(blockHash);
+      m_invTimeouts.Cancel(blockHash);
     }
   }
   else
@@ -2326,11 +2673,10 @@ BitcoinNode::ReceiveBlock(const Block &newBlock)
 	//PrintQueueInv();
 	//PrintInvTimeouts();
 	
-    if (m_invTimeouts.find(blockHash) != m_invTimeouts.end())
+    if (m_invTimeouts.IsArmed(blockHash))
     {
       m_queueInv.erase(blockHash);
-      Simulator::Cancel (m_invTimeouts[blockHash]);
-      m_invTimeouts.erase(blockHash);
+      m_invTimeouts.Cancel(blockHash);
     }
 	
     //PrintQueueInv();
@@ -2347,6 +2693,7 @@ BitcoinNode::ReceivedLastChunk(const Block &newBlock)
   NS_LOG_INFO ("ReceivedLastChunk: At time " << Simulator::Now ().GetSeconds ()
                 << "s bitcoin node " << GetNode ()->GetId () 
                 << " received the last chunk of block " << newBlock);
+  m_blockReceivedTrace (MakeBlockTrace (newBlock));
 				
   std::ostringstream   stringStream;  
   std::string          blockHash = stringStream.str();
@@ -2376,6 +2723,7 @@ void
 BitcoinNode::SendBlock(std::string packetInfo, Address& from) 
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (SEND_BLOCK_HANDLER);
   
   NS_LOG_INFO ("SendBlock: At time " << Simulator::Now ().GetSeconds ()
                 << "s bitcoin node " << GetNode ()->GetId () << " sent " 
@@ -2390,6 +2738,7 @@ void
 BitcoinNode::SendChunk(std::string packetInfo, Address& from) 
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (SEND_CHUNK_HANDLER);
   
   NS_LOG_INFO ("SendChunk: At time " << Simulator::Now ().GetSeconds ()
                 << "s bitcoin node " << GetNode ()->GetId () << " sent " 
@@ -2419,8 +2768,29 @@ BitcoinNode::ValidateBlock(const Block &newBlock)
   {
     NS_LOG_INFO("ValidateBlock: Block " << newBlock << " is an orphan\n"); 
 	 
-	 m_blockchain.AddOrphan(newBlock);
-	 //m_blockchain.PrintOrphans();
+    Block evicted = m_blockchain.AddOrphan(newBlock);
+    m_orphanAddedTrace (MakeBlockTrace (newBlock));
+
+    /**
+     * The hop of an orphan would include the wait for its parent, so it is not decomposed
+     */
+    std::ostringstream orphanHash;
+
+    orphanHash << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
+    m_blockHops.erase(orphanHash.str());
+    //m_blockchain.PrintOrphans();
+
+    /**
+     * The evicted orphan is forgotten, so that it can be requested again when announced
+     */
+    if (evicted.GetBlockHeight() >= 0)
+    {
+      std::ostringstream stringStream;
+
+      stringStream << evicted.GetBlockHeight() << "/" << evicted.GetMinerId();
+      NS_LOG_INFO("ValidateBlock: The orphan pool is full, evicted " << evicted);
+      RemoveReceivedButNotValidated(stringStream.str());
+    }
   }
   else 
   {
@@ -2434,7 +2804,7 @@ BitcoinNode::ValidateBlock(const Block &newBlock)
     const double averageValidationTimeSeconds = 0.174;
     double validationTime = averageValidationTimeSeconds * newBlock.GetBlockSizeBytes() / averageBlockSizeBytes;		
 	
-    Simulator::Schedule (Seconds(validationTime), &BitcoinNode::AfterBlockValidation, this, newBlock);
+    EventCensus::Schedule (AFTER_BLOCK_VALIDATION_EVENT, Seconds(validationTime), &BitcoinNode::AfterBlockValidation, this, newBlock);
     NS_LOG_INFO ("ValidateBlock: The Block " << newBlock << " will be validated in " 
                  << validationTime << "s");
   }  
@@ -2445,6 +2815,7 @@ void
 BitcoinNode::AfterBlockValidation(const Block &newBlock) 
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (AFTER_BLOCK_VALIDATION_HANDLER);
 
   int height = newBlock.GetBlockHeight();
   int minerId = newBlock.GetMinerId();
@@ -2484,9 +2855,27 @@ BitcoinNode::AfterBlockValidation(const Block &newBlock)
   m_meanBlockSize = (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks())*m_meanBlockSize  
                   + (newBlock.GetBlockSizeBytes())/static_cast<double>(m_blockchain.GetTotalBlocks());
 				  
+  Block oldTop (*m_blockchain.GetCurrentTopBlock());
+  int   noReorgs = m_blockchain.GetNoReorgs();
+
+  m_blockValidationTimes[BlockId (newBlock.GetBlockHeight (), newBlock.GetMinerId ())] = Simulator::Now ().GetSeconds ();
   m_blockchain.AddBlock(newBlock);
+  m_blockValidatedTrace (MakeBlockTrace (newBlock));
+
+  if (m_blockchain.GetNoReorgs() > noReorgs)
+  {
+    reorgTrace reorg = {static_cast<int> (GetNode ()->GetId ()), oldTop.GetBlockHeight (), oldTop.GetMinerId (),
+                        newBlock.GetBlockHeight (), newBlock.GetMinerId (), m_blockchain.GetLastReorgDepth ()};
+
+    NS_LOG_INFO ("AfterBlockValidation: Block " << newBlock << " replaced the top block " << oldTop 
+                 << ", " << reorg.depth << " blocks left the main chain");
+    m_chainReorgTrace (reorg);
+  }
+  RecordPropagationHop (newBlock);
   
-  if (!m_blockTorrent)
+  if (m_trickleInv)
+    TrickleNewBlock(newBlock, !m_blockTorrent);
+  else if (!m_blockTorrent)
     AdvertiseNewBlock(newBlock); 
   else
     AdvertiseFullBlock(newBlock);
@@ -2522,354 +2911,305 @@ BitcoinNode::ValidateOrphanChildren(const Block &newBlock)
 
 
 void 
-BitcoinNode::AdvertiseNewBlock (const Block &newBlock) 
+BitcoinNode::SelectAnnouncementPolicy (void) 
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_protocolType == STANDARD_PROTOCOL && !m_blockTorrent)
+  {
+    m_buildAnnouncement = &AnnouncementPolicy<STANDARD_PROTOCOL, false>::Build;
+    m_announcementSentBytes = AnnouncementPolicy<STANDARD_PROTOCOL, false>::GetSentBytes ();
+  }
+  else if (m_protocolType == STANDARD_PROTOCOL && m_blockTorrent)
+  {
+    m_buildAnnouncement = &AnnouncementPolicy<STANDARD_PROTOCOL, true>::Build;
+    m_announcementSentBytes = AnnouncementPolicy<STANDARD_PROTOCOL, true>::GetSentBytes ();
+  }
+  else if (m_protocolType == SENDHEADERS && !m_blockTorrent)
+  {
+    m_buildAnnouncement = &AnnouncementPolicy<SENDHEADERS, false>::Build;
+    m_announcementSentBytes = AnnouncementPolicy<SENDHEADERS, false>::GetSentBytes ();
+  }
+  else if (m_protocolType == SENDHEADERS && m_blockTorrent)
+  {
+    m_buildAnnouncement = &AnnouncementPolicy<SENDHEADERS, true>::Build;
+    m_announcementSentBytes = AnnouncementPolicy<SENDHEADERS, true>::GetSentBytes ();
+  }
+  else
+    NS_FATAL_ERROR ("Unknown protocol type " << m_protocolType);
+}
+
+
+void 
+BitcoinNode::AnnounceBlock (const Block &newBlock, const std::vector<int> *availableChunks, bool skipSender, const char *caller) 
 {
   NS_LOG_FUNCTION (this);
 
   rapidjson::Document d;
-  rapidjson::Value value;
-  rapidjson::Value array(rapidjson::kArrayType);  
-  std::ostringstream stringStream;  
-  std::string blockHash = stringStream.str();
+  rapidjson::Value    value;
+  std::vector<Block>  blocks (1, newBlock);
   d.SetObject();
-  
+
   value.SetString("block");
   d.AddMember("type", value, d.GetAllocator());
+
+  long bytes = m_buildAnnouncement (d, blocks, availableChunks);
+
+  // Stringify the DOM
+  rapidjson::StringBuffer packetInfo;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
+  d.Accept(writer);
   
-  if (m_protocolType == STANDARD_PROTOCOL)
+  for (uint32_t i = 0; i < m_peersAddresses.size(); ++i)
   {
-    value = INV;
-    d.AddMember("message", value, d.GetAllocator());
+    if (skipSender && m_peersAddresses[i] == newBlock.GetReceivedFromIpv4 ())
+      continue;
 
-    stringStream << newBlock.GetBlockHeight () << "/" << newBlock.GetMinerId ();
-    blockHash = stringStream.str();
-    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
-    array.PushBack(value, d.GetAllocator());
-    d.AddMember("inv", array, d.GetAllocator());
-  }
-  else if (m_protocolType == SENDHEADERS)
-  {
-    rapidjson::Value blockInfo(rapidjson::kObjectType);
+    const uint8_t delimiter[] = "#";
 
-    value = HEADERS;
-    d.AddMember("message", value, d.GetAllocator());
+    m_peerSockets[i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
+    m_peerSockets[i]->Send (delimiter, 1, 0);
+    TraceMessageSent (static_cast<enum Messages>(d["message"].GetInt()), m_peersAddresses[i], packetInfo.GetSize() + 1);
+    m_nodeStats->*m_announcementSentBytes += bytes;
 	
-    value = newBlock.GetBlockHeight ();
-    blockInfo.AddMember("height", value, d.GetAllocator ());
+    NS_LOG_INFO (caller << ": At time " << Simulator::Now ().GetSeconds ()
+                 << "s bitcoin node " << GetNode ()->GetId () << " advertised a new Block: " 
+                 << newBlock << " to " << m_peersAddresses[i]);
+  }
+}
 
-    value = newBlock.GetMinerId ();
-    blockInfo.AddMember("minerId", value, d.GetAllocator ());
 
-    value = newBlock.GetParentBlockMinerId ();
-    blockInfo.AddMember("parentBlockMinerId", value, d.GetAllocator ());
+void 
+BitcoinNode::AdvertiseNewBlock (const Block &newBlock) 
+{
+  NS_LOG_FUNCTION (this);
 
-    value = newBlock.GetBlockSizeBytes ();
-    blockInfo.AddMember("size", value, d.GetAllocator ());
+  AnnounceBlock (newBlock, nullptr, true, "AdvertiseNewBlock");
+}
 
-    value = newBlock.GetTimeCreated ();
-    blockInfo.AddMember("timeCreated", value, d.GetAllocator ());
 
-    value = newBlock.GetTimeReceived ();							
-    blockInfo.AddMember("timeReceived", value, d.GetAllocator ());
+void 
+BitcoinNode::AdvertiseFullBlock (const Block &newBlock) 
+{
+  NS_LOG_FUNCTION (this);
 
-    array.PushBack(blockInfo, d.GetAllocator());
-    d.AddMember("blocks", array, d.GetAllocator());      
-  }	
+  AnnounceBlock (newBlock, nullptr, false, "AdvertiseFullBlock");
+}
 
-  // Stringify the DOM
-  rapidjson::StringBuffer packetInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-  d.Accept(writer);
-  
-  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+
+void 
+BitcoinNode::AdvertiseFirstChunk (const Block &newBlock) 
+{
+  NS_LOG_FUNCTION (this);
+
+  std::ostringstream stringStream;  
+  std::string blockHash;
+  int noChunks = ceil(newBlock.GetBlockSizeBytes ()/static_cast<double>(m_chunkSize));
+
+  stringStream << newBlock.GetBlockHeight () << "/" << newBlock.GetMinerId ();
+  blockHash = stringStream.str();
+
+  if (m_receivedChunks[blockHash].size() == noChunks)
+    AnnounceBlock (newBlock, nullptr, true, "AdvertiseFirstChunk");
+  else
+    AnnounceBlock (newBlock, &m_receivedChunks[blockHash], true, "AdvertiseFirstChunk");
+}
+
+
+void 
+BitcoinNode::TrickleNewBlock (const Block &newBlock, bool skipSender) 
+{
+  NS_LOG_FUNCTION (this);
+
+  for (uint32_t i = 0; i < m_peersAddresses.size(); ++i)
   {
-    if ( *i != newBlock.GetReceivedFromIpv4 () )
+    if (skipSender && m_peersAddresses[i] == newBlock.GetReceivedFromIpv4 ())
+      continue;
+
+    m_peerPendingInv[i].push_back(newBlock);
+
+    /**
+     * Arm the trickle timer of the peer, if it is not already armed
+     */
+    if (!m_peerTrickleEvents[i].IsRunning ())
     {
-      const uint8_t delimiter[] = "#";
+      double trickleInterval = m_trickleIntervals->GetValue (m_trickleMeanInterval.GetSeconds (), 0);
+      m_peerTrickleEvents[i] = EventCensus::Schedule (FLUSH_PENDING_INV_EVENT, Seconds(trickleInterval), &BitcoinNode::FlushPendingInv, this, i);
 
-      m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-	  m_peersSockets[*i]->Send (delimiter, 1, 0);
-	  
-      if (m_protocolType == STANDARD_PROTOCOL)
-        m_nodeStats->invSentBytes += m_bitcoinMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
-      else if (m_protocolType == SENDHEADERS)
-        m_nodeStats->headersSentBytes += m_bitcoinMessageHeader + m_countBytes + d["blocks"].Size()*m_headersSizeBytes;      
-	
-      NS_LOG_INFO ("AdvertiseNewBlock: At time " << Simulator::Now ().GetSeconds ()
-                   << "s bitcoin node " << GetNode ()->GetId () << " advertised a new Block: " 
-                   << newBlock << " to " << *i);
+      NS_LOG_INFO ("TrickleNewBlock: At time " << Simulator::Now ().GetSeconds ()
+                   << "s bitcoin node " << GetNode ()->GetId () << " will flush its pending inventory to " 
+                   << m_peersAddresses[i] << " in " << trickleInterval << "s");
     }
   }
 }
 
 
 void 
-BitcoinNode::AdvertiseFullBlock (const Block &newBlock) 
+BitcoinNode::FlushPendingInv (uint32_t peer) 
 {
   NS_LOG_FUNCTION (this);
 
+  std::vector<Block> pendingBlocks;
+  pendingBlocks.swap(m_peerPendingInv[peer]);
+
+  if (pendingBlocks.empty())
+    return;
+
   rapidjson::Document d;
   rapidjson::Value value;
-  rapidjson::Value array(rapidjson::kArrayType);  
-  rapidjson::Value blockInfo(rapidjson::kObjectType);
-  std::ostringstream stringStream;  
-  std::string blockHash = stringStream.str();
   d.SetObject();
   
   value.SetString("block");
   d.AddMember("type", value, d.GetAllocator());
-  
-  if (m_protocolType == STANDARD_PROTOCOL)
-  {
-    value = EXT_INV;
-    d.AddMember("message", value, d.GetAllocator());
-  
-    stringStream << newBlock.GetBlockHeight () << "/" << newBlock.GetMinerId ();
-    blockHash = stringStream.str();
-    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
-    blockInfo.AddMember("hash", value, d.GetAllocator ());
 
-    value = newBlock.GetBlockSizeBytes ();
-    blockInfo.AddMember("size", value, d.GetAllocator ());
-		  
-    value = true;
-    blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
-	
-    array.PushBack(blockInfo, d.GetAllocator());
-    d.AddMember("inv", array, d.GetAllocator());
-  }
-  else if (m_protocolType == SENDHEADERS)
-  {
-    rapidjson::Value blockInfo(rapidjson::kObjectType);
+  long bytes = m_buildAnnouncement (d, pendingBlocks, nullptr);
 
-    value = newBlock.GetBlockHeight ();
-    blockInfo.AddMember("height", value, d.GetAllocator ());
+  // Stringify the DOM
+  rapidjson::StringBuffer packetInfo;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
+  d.Accept(writer);
 
-    value = newBlock.GetMinerId ();
-    blockInfo.AddMember("minerId", value, d.GetAllocator ());
+  const uint8_t delimiter[] = "#";
 
-    value = newBlock.GetParentBlockMinerId ();
-    blockInfo.AddMember("parentBlockMinerId", value, d.GetAllocator ());
+  m_peerSockets[peer]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
+  m_peerSockets[peer]->Send (delimiter, 1, 0);
+  TraceMessageSent (static_cast<enum Messages>(d["message"].GetInt()), m_peersAddresses[peer], packetInfo.GetSize() + 1);
+  m_nodeStats->*m_announcementSentBytes += bytes;
 
-    value = newBlock.GetBlockSizeBytes ();
-    blockInfo.AddMember("size", value, d.GetAllocator ());
+  NS_LOG_INFO ("FlushPendingInv: At time " << Simulator::Now ().GetSeconds ()
+               << "s bitcoin node " << GetNode ()->GetId () << " advertised " 
+               << pendingBlocks.size() << " blocks to " << m_peersAddresses[peer]);
+}
 
-    value = newBlock.GetTimeCreated ();
-    blockInfo.AddMember("timeCreated", value, d.GetAllocator ());
 
-    value = newBlock.GetTimeReceived ();							
-    blockInfo.AddMember("timeReceived", value, d.GetAllocator ());
+blockTrace
+BitcoinNode::MakeBlockTrace (const Block &block) const
+{
+  blockTrace trace = {static_cast<int> (GetNode ()->GetId ()), block.GetBlockHeight(), block.GetMinerId(),
+                      block.GetBlockSizeBytes(), block.GetTimeCreated(), block.GetReceivedFromIpv4().Get()};
+  return trace;
+}
 
-    if (!m_blockTorrent)
-    {
-      value = HEADERS;
-      d.AddMember("message", value, d.GetAllocator()); 
-    }
-    else
-    {
-      value = EXT_HEADERS;
-      d.AddMember("message", value, d.GetAllocator());
-		  
-      value = true;
-      blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
-    }
-	
-    array.PushBack(blockInfo, d.GetAllocator());
-    d.AddMember("blocks", array, d.GetAllocator());      
-  }	
 
-  // Stringify the DOM
-  rapidjson::StringBuffer packetInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-  d.Accept(writer);
-  
-  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+void
+BitcoinNode::TraceMessageSent (enum Messages message, Ipv4Address peer, uint32_t bytes)
+{
+  messageTrace trace = {static_cast<int> (GetNode ()->GetId ()), message, peer.Get(), bytes};
+  m_messageSentTrace (trace);
+}
+
+
+void
+BitcoinNode::RecordBlockRequest (const std::string &blockHash, Ipv4Address peer)
+{
+  NS_LOG_FUNCTION (this);
+
+  std::map<std::string, pendingHop>::iterator it = m_blockHops.find(blockHash);
+
+  if (it == m_blockHops.end())
   {
-    const uint8_t delimiter[] = "#";
+    pendingHop pending;
 
-    m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-    m_peersSockets[*i]->Send (delimiter, 1, 0);
-	  
-    if (m_protocolType == STANDARD_PROTOCOL)
-    {
-      m_nodeStats->extInvSentBytes += m_bitcoinMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
-      for (int j=0; j<d["inv"].Size(); j++)
-      {
-        m_nodeStats->extInvSentBytes += 5; //1Byte(fullBlock) + 4Bytes(numberOfChunks)
-        if (!d["inv"][j]["fullBlock"].GetBool())
-          m_nodeStats->extInvSentBytes += d["inv"][j]["availableChunks"].Size();
-      }
-    }
-    else if (m_protocolType == SENDHEADERS)
-    {
-      m_nodeStats->extHeadersSentBytes += m_bitcoinMessageHeader + m_countBytes + d["blocks"].Size()*m_headersSizeBytes;
-      for (int j=0; j<d["blocks"].Size(); j++)
-      {
-        m_nodeStats->extHeadersSentBytes += 1;//fullBlock
-        if (!d["blocks"][j]["fullBlock"].GetBool())
-          m_nodeStats->extHeadersSentBytes += d["blocks"][j]["availableChunks"].Size()*1;
-      }	
-    }
-	
-    NS_LOG_INFO ("AdvertiseFullBlock: At time " << Simulator::Now ().GetSeconds ()
-                 << "s bitcoin node " << GetNode ()->GetId () << " advertised a new Block: " 
-                 << newBlock << " to " << *i);
+    pending.timeRequested[peer] = Simulator::Now ().GetSeconds ();
+    pending.timeBlockMessage = -1;
+    m_blockHops[blockHash] = pending;
   }
+  else if (it->second.timeBlockMessage < 0)
+    it->second.timeRequested[peer] = Simulator::Now ().GetSeconds ();
 }
 
 
-void 
-BitcoinNode::AdvertiseFirstChunk (const Block &newBlock) 
+void
+BitcoinNode::RecordBlockMessage (const rapidjson::Value &blocks, Ipv4Address peer, double transmissionTime, double downloadQueueingTime)
 {
   NS_LOG_FUNCTION (this);
 
-  rapidjson::Document d;
-  rapidjson::Value value;
-  rapidjson::Value array(rapidjson::kArrayType); 
-  rapidjson::Value chunkArray(rapidjson::kArrayType); 
-  rapidjson::Value blockInfo(rapidjson::kObjectType);  
-  std::ostringstream stringStream;  
-  std::string blockHash;
-  int noChunks = ceil(newBlock.GetBlockSizeBytes ()/static_cast<double>(m_chunkSize));
+  for (rapidjson::SizeType j = 0; j < blocks.Size(); j++)
+  {
+    std::ostringstream   stringStream;
 
-  d.SetObject();
-  stringStream << newBlock.GetBlockHeight () << "/" << newBlock.GetMinerId ();
-  blockHash = stringStream.str();
+    stringStream << blocks[j]["height"].GetInt() << "/" << blocks[j]["minerId"].GetInt();
 
-  value.SetString("block");
-  d.AddMember("type", value, d.GetAllocator());
-  
-  if (m_protocolType == STANDARD_PROTOCOL)
-  {
-    value = EXT_INV;
-    d.AddMember("message", value, d.GetAllocator());
-        
-    value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
-    blockInfo.AddMember("hash", value, d.GetAllocator ());
+    std::map<std::string, pendingHop>::iterator it = m_blockHops.find(stringStream.str());
 
-    value =  newBlock.GetBlockSizeBytes ();
-    blockInfo.AddMember("size", value, d.GetAllocator ());
-		  
-					
-    if (m_receivedChunks[blockHash].size() == noChunks)
+    /**
+     * Only the first BLOCK message of a requested block counts
+     */
+    if (it == m_blockHops.end() || it->second.timeBlockMessage >= 0)
+      continue;
+
+    /**
+     * Blocks pushed without a GET_DATA do not carry the delays of the sender
+     */
+    if (!blocks[j].HasMember("uploadQueueing") || !blocks[j].HasMember("timeValidated"))
     {
-      value = true;
-      blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
+      m_blockHops.erase(it);
+      continue;
     }
-    else
-    {
-      value = false;							
-      blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
 
-      for (auto &chunk : m_receivedChunks[blockHash])
-      {
-        value = chunk;
-        chunkArray.PushBack(value, d.GetAllocator());
-      }
-      blockInfo.AddMember("availableChunks", chunkArray, d.GetAllocator ());
-    }
-		  
-    array.PushBack(blockInfo, d.GetAllocator());
-    d.AddMember("inv", array, d.GetAllocator()); 
-  }
-  else if (m_protocolType == SENDHEADERS)
-  {
-    rapidjson::Value blockInfo(rapidjson::kObjectType);
+    pendingHop &pending = it->second;
 
-    value = newBlock.GetBlockHeight ();
-    blockInfo.AddMember("height", value, d.GetAllocator ());
+    /**
+     * The delays are measured against the request sent to this peer, since the block
+     * may have been requested from other peers too after an inv timeout
+     */
+    std::map<Ipv4Address, double>::iterator requested = pending.timeRequested.find(peer);
+
+    if (requested == pending.timeRequested.end())
+      continue;
+
+    double timeRequested = requested->second;
+    double uploadQueueingTime = blocks[j]["uploadQueueing"].GetDouble();
+
+    pending.timeBlockMessage = Simulator::Now ().GetSeconds ();
+    pending.hop.delays[ANNOUNCEMENT_HOP_DELAY] = timeRequested - blocks[j]["timeValidated"].GetDouble();
+    pending.hop.delays[REQUEST_RTT_HOP_DELAY] = pending.timeBlockMessage - timeRequested - uploadQueueingTime;
+    pending.hop.delays[UPLOAD_QUEUEING_HOP_DELAY] = uploadQueueingTime;
+    pending.hop.delays[TRANSMISSION_HOP_DELAY] = transmissionTime;
+    pending.hop.delays[DOWNLOAD_QUEUEING_HOP_DELAY] = downloadQueueingTime;
+  }
+}
 
-    value = newBlock.GetMinerId ();
-    blockInfo.AddMember("minerId", value, d.GetAllocator ());
 
-    value = newBlock.GetParentBlockMinerId ();
-    blockInfo.AddMember("parentBlockMinerId", value, d.GetAllocator ());
+void
+BitcoinNode::RecordPropagationHop (const Block &newBlock)
+{
+  NS_LOG_FUNCTION (this);
 
-    value = newBlock.GetBlockSizeBytes ();
-    blockInfo.AddMember("size", value, d.GetAllocator ());
+  std::ostringstream   stringStream;
 
-    value = newBlock.GetTimeCreated ();
-    blockInfo.AddMember("timeCreated", value, d.GetAllocator ());
+  stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
 
-    value = newBlock.GetTimeReceived ();							
-    blockInfo.AddMember("timeReceived", value, d.GetAllocator ());
+  std::map<std::string, pendingHop>::iterator it = m_blockHops.find(stringStream.str());
 
-    if (!m_blockTorrent)
-    {
-      value = HEADERS;
-      d.AddMember("message", value, d.GetAllocator()); 
-    }
-    else
-    {
-      value = EXT_HEADERS;
-      d.AddMember("message", value, d.GetAllocator());
-		  
-      if (m_receivedChunks[blockHash].size() == noChunks)
-      {
-        value = true;
-        blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
-        NS_LOG_DEBUG("1 " << m_receivedChunks[blockHash].size());
-      }
-      else
-      {
-        rapidjson::Value availableChunks(rapidjson::kArrayType);
-		
-        value = false;
-        blockInfo.AddMember("fullBlock", value, d.GetAllocator ());
-					  
-        for (auto &c : m_receivedChunks[blockHash])
-        {
-          value = c;
-          availableChunks.PushBack(value, d.GetAllocator());
-        }
-        blockInfo.AddMember("availableChunks", availableChunks, d.GetAllocator ());
-      }
-    }
-	
-    array.PushBack(blockInfo, d.GetAllocator());
-    d.AddMember("blocks", array, d.GetAllocator());      
-  }	
+  if (it == m_blockHops.end())
+    return;
 
-  // Stringify the DOM
-  rapidjson::StringBuffer packetInfo;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-  d.Accept(writer);
-  
-  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+  if (it->second.timeBlockMessage >= 0)
   {
-    if ( *i != newBlock.GetReceivedFromIpv4 () )
-    {
-      const uint8_t delimiter[] = "#";
+    hopTrace &hop = it->second.hop;
 
-      m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-      m_peersSockets[*i]->Send (delimiter, 1, 0);
-	  
-      if (m_protocolType == STANDARD_PROTOCOL)
-      {
-        m_nodeStats->extInvSentBytes += m_bitcoinMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
-        for (int j=0; j<d["inv"].Size(); j++)
-        {
-          m_nodeStats->extInvSentBytes += 5; //1Byte(fullBlock) + 4Bytes(numberOfChunks)
-          if (!d["inv"][j]["fullBlock"].GetBool())
-            m_nodeStats->extInvSentBytes += d["inv"][j]["availableChunks"].Size();
-        }
-      }
-      else if (m_protocolType == SENDHEADERS)
-      {
-        m_nodeStats->extHeadersSentBytes += m_bitcoinMessageHeader + m_countBytes + d["blocks"].Size()*m_headersSizeBytes;
-        for (int j=0; j<d["blocks"].Size(); j++)
-        {
-          m_nodeStats->extHeadersSentBytes += 1;//fullBlock
-          if (!d["blocks"][j]["fullBlock"].GetBool())
-            m_nodeStats->extHeadersSentBytes += d["blocks"][j]["availableChunks"].Size()*1;
-        }	
-      } 
-	
-      NS_LOG_INFO ("AdvertiseFirstChunk: At time " << Simulator::Now ().GetSeconds ()
-                   << "s bitcoin node " << GetNode ()->GetId () << " advertised a new chunk: " 
-                   << newBlock << " to " << *i);
+    hop.nodeId = GetNode ()->GetId ();
+    hop.blockHeight = newBlock.GetBlockHeight ();
+    hop.minerId = newBlock.GetMinerId ();
+    hop.peer = newBlock.GetReceivedFromIpv4 ().Get ();
+    hop.delays[VALIDATION_HOP_DELAY] = Simulator::Now ().GetSeconds () - newBlock.GetTimeReceived ();
+
+    m_nodeStats->propagationHops++;
+    for (int i = 0; i < NO_HOP_DELAYS; i++)
+    {
+      m_nodeStats->meanHopDelays[i] = (m_nodeStats->propagationHops - 1)/static_cast<double>(m_nodeStats->propagationHops)*m_nodeStats->meanHopDelays[i]
+                                    + hop.delays[i]/m_nodeStats->propagationHops;
     }
+
+    NS_LOG_INFO ("RecordPropagationHop: Block " << newBlock << " announcement = " << hop.delays[ANNOUNCEMENT_HOP_DELAY]
+                 << "s, request RTT = " << hop.delays[REQUEST_RTT_HOP_DELAY] << "s, upload queueing = " << hop.delays[UPLOAD_QUEUEING_HOP_DELAY]
+                 << "s, transmission = " << hop.delays[TRANSMISSION_HOP_DELAY] << "s, download queueing = " << hop.delays[DOWNLOAD_QUEUEING_HOP_DELAY]
+                 << "s, validation = " << hop.delays[VALIDATION_HOP_DELAY] << "s");
+    m_blockHopTrace (hop);
   }
+
+  m_blockHops.erase(it);
 }
 
 
@@ -2893,6 +3233,10 @@ BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseM
   outgoingSocket->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
   outgoingSocket->Send (delimiter, 1, 0);	
 
+  std::vector<Ptr<Socket>>::const_iterator peerSocket = std::find (m_peerSockets.begin(), m_peerSockets.end(), outgoingSocket);
+  TraceMessageSent (responseMessage, peerSocket == m_peerSockets.end() ? Ipv4Address () : m_peersAddresses[peerSocket - m_peerSockets.begin()],
+                    buffer.GetSize() + 1);
+
   switch (d["message"].GetInt()) 
   {
     case INV:
@@ -3000,16 +3344,17 @@ BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseM
                << " message: " << buffer.GetString());
 			
   Ipv4Address outgoingIpv4Address = InetSocketAddress::ConvertFrom(outgoingAddress).GetIpv4 ();
-  std::map<Ipv4Address, Ptr<Socket>>::iterator it = m_peersSockets.find(outgoingIpv4Address);
+  uint32_t peerIndex = GetPeerIndex (outgoingIpv4Address);
   
-  if (it == m_peersSockets.end()) //Create the socket if it doesn't exist
+  if (!m_peerSockets[peerIndex]) //Create the socket if it doesn't exist
   {
-    m_peersSockets[outgoingIpv4Address] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());  
-    m_peersSockets[outgoingIpv4Address]->Connect (InetSocketAddress (outgoingIpv4Address, m_bitcoinPort));
+    m_peerSockets[peerIndex] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());  
+    m_peerSockets[peerIndex]->Connect (InetSocketAddress (outgoingIpv4Address, m_bitcoinPort));
   }
   
-  m_peersSockets[outgoingIpv4Address]->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-  m_peersSockets[outgoingIpv4Address]->Send (delimiter, 1, 0);	
+  m_peerSockets[peerIndex]->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
+  m_peerSockets[peerIndex]->Send (delimiter, 1, 0);	
+  TraceMessageSent (responseMessage, outgoingIpv4Address, buffer.GetSize() + 1);
 
   switch (d["message"].GetInt()) 
   {
@@ -3121,16 +3466,17 @@ BitcoinNode::SendMessage(enum Messages receivedMessage,  enum Messages responseM
                << " message: " << buffer.GetString());
 			
   Ipv4Address outgoingIpv4Address = InetSocketAddress::ConvertFrom(outgoingAddress).GetIpv4 ();
-  std::map<Ipv4Address, Ptr<Socket>>::iterator it = m_peersSockets.find(outgoingIpv4Address);
+  uint32_t peerIndex = GetPeerIndex (outgoingIpv4Address);
   
-  if (it == m_peersSockets.end()) //Create the socket if it doesn't exist
+  if (!m_peerSockets[peerIndex]) //Create the socket if it doesn't exist
   {
-    m_peersSockets[outgoingIpv4Address] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());  
-    m_peersSockets[outgoingIpv4Address]->Connect (InetSocketAddress (outgoingIpv4Address, m_bitcoinPort));
+    m_peerSockets[peerIndex] = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());  
+    m_peerSockets[peerIndex]->Connect (InetSocketAddress (outgoingIpv4Address, m_bitcoinPort));
   }
   
-  m_peersSockets[outgoingIpv4Address]->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-  m_peersSockets[outgoingIpv4Address]->Send (delimiter, 1, 0);	
+  m_peerSockets[peerIndex]->Send (reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
+  m_peerSockets[peerIndex]->Send (delimiter, 1, 0);	
+  TraceMessageSent (responseMessage, outgoingIpv4Address, buffer.GetSize() + 1);
 
   
   switch (d["message"].GetInt()) 
@@ -3252,9 +3598,9 @@ BitcoinNode::PrintInvTimeouts()
 
   std::cout << "Node " <<  GetNode()->GetId() << ": The m_invTimeouts is:\n";
   
-  for(auto &elem : m_invTimeouts)
+  for(auto &elem : m_invTimeouts.GetArmedKeys())
   {
-    std::cout << "  " << elem.first << ":\n";
+    std::cout << "  " << elem << ":\n";
   }
   std::cout << std::endl;
 }
@@ -3267,9 +3613,9 @@ BitcoinNode::PrintChunkTimeouts()
 
   std::cout << "Node " <<  GetNode()->GetId() << ": The m_chunkTimeouts is:\n";
   
-  for(auto &elem : m_chunkTimeouts)
+  for(auto &elem : m_chunkTimeouts.GetArmedKeys())
   {
-    std::cout << "  " << elem.first << ":\n";
+    std::cout << "  " << elem << ":\n";
   }
   std::cout << std::endl;
 }
@@ -3363,6 +3709,7 @@ void
 BitcoinNode::InvTimeoutExpired(std::string blockHash)
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (INV_TIMEOUT_EXPIRED_HANDLER);
 
   std::string   invDelimiter = "/";
   size_t        invPos = blockHash.find(invDelimiter);
@@ -3374,11 +3721,12 @@ BitcoinNode::InvTimeoutExpired(std::string blockHash)
                 << " the timeout for block " << blockHash << " expired");
   
   m_nodeStats->blockTimeouts ++;
+  timeoutTrace trace = {static_cast<int> (GetNode ()->GetId ()), height, minerId, -1};
+  m_timeoutFiredTrace (trace);
   //PrintQueueInv();
   //PrintInvTimeouts();
   
   m_queueInv[blockHash].erase(m_queueInv[blockHash].begin());
-  m_invTimeouts.erase(blockHash);
   
   //PrintQueueInv();
   //PrintInvTimeouts();
@@ -3386,7 +3734,6 @@ BitcoinNode::InvTimeoutExpired(std::string blockHash)
   if (!m_queueInv[blockHash].empty() && !m_blockchain.HasBlock(height, minerId) && !m_blockchain.IsOrphan(height, minerId) && !ReceivedButNotValidated(blockHash))
   {
     rapidjson::Document   d; 
-    EventId               timeout;
     rapidjson::Value      value(INV);
     rapidjson::Value      array(rapidjson::kArrayType);
 	
@@ -3409,11 +3756,14 @@ BitcoinNode::InvTimeoutExpired(std::string blockHash)
     SendMessage(INV, GET_HEADERS, d, *(m_queueInv[blockHash].begin()));				
     SendMessage(INV, GET_DATA, d, *(m_queueInv[blockHash].begin()));	
 					
-    timeout = Simulator::Schedule (m_invTimeoutMinutes, &BitcoinNode::InvTimeoutExpired, this, blockHash);
-    m_invTimeouts[blockHash] = timeout;
+    ArmInvTimeout (blockHash, m_invTimeoutMinutes);
+    RecordBlockRequest (blockHash, InetSocketAddress::ConvertFrom(*(m_queueInv[blockHash].begin())).GetIpv4 ());
   }
   else
+  {
     m_queueInv.erase(blockHash);
+    m_blockHops.erase(blockHash);
+  }
     
   //PrintQueueInv();
   //PrintInvTimeouts();
@@ -3424,6 +3774,7 @@ void
 BitcoinNode::ChunkTimeoutExpired(std::string chunk)
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (CHUNK_TIMEOUT_EXPIRED_HANDLER);
 
   std::string            invDelimiter = "/";
   std::string            chunkHashHelp = chunk.substr(0);
@@ -3447,12 +3798,13 @@ BitcoinNode::ChunkTimeoutExpired(std::string chunk)
                 << " the timeout for chunk " << chunk << " expired");
 				
   m_nodeStats->chunkTimeouts ++;
+  timeoutTrace trace = {static_cast<int> (GetNode ()->GetId ()), height, minerId, chunkId};
+  m_timeoutFiredTrace (trace);
 
 /*   PrintChunkTimeouts();
   PrintQueueChunks();
   PrintQueueChunkPeers(); */
   
-  m_chunkTimeouts.erase(chunk);
   m_queueChunks[blockHash].push_back(chunkId);
   
 /*   PrintChunkTimeouts();
@@ -3461,6 +3813,67 @@ BitcoinNode::ChunkTimeoutExpired(std::string chunk)
 }
 
 
+void
+BitcoinNode::ArmInvTimeout (const std::string &blockHash, Time timeout)
+{
+  NS_LOG_FUNCTION (this);
+
+  /**
+   * The next tick can be anywhere in the current interval, so one more tick keeps the timeout from expiring early
+   */
+  m_invTimeouts.Arm(blockHash, ceil(timeout.GetSeconds() / m_timeoutTickInterval.GetSeconds()) + 1);
+  ScheduleTimeoutTick();
+}
+
+
+void
+BitcoinNode::ArmChunkTimeout (const std::string &chunk, Time timeout)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_chunkTimeouts.Arm(chunk, ceil(timeout.GetSeconds() / m_timeoutTickInterval.GetSeconds()) + 1);
+  ScheduleTimeoutTick();
+}
+
+
+void
+BitcoinNode::ScheduleTimeoutTick (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  /**
+   * The wheels are only ticking while they hold armed timeouts
+   */
+  if (!m_timeoutTickEvent.IsRunning())
+    m_timeoutTickEvent = EventCensus::Schedule (TIMEOUT_TICK_EVENT, m_timeoutTickInterval, &BitcoinNode::TimeoutTick, this);
+}
+
+
+void
+BitcoinNode::TimeoutTick (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  /**
+   * The executing tick is still reported as running, so forget it before the expired timeouts re-arm
+   * and schedule the next one
+   */
+  m_timeoutTickEvent = EventId ();
+
+  std::vector<std::string> expiredBlocks = m_invTimeouts.Advance();
+  std::vector<std::string> expiredChunks = m_chunkTimeouts.Advance();
+
+  for (auto &blockHash : expiredBlocks)
+    InvTimeoutExpired(blockHash);
+
+  for (auto &chunk : expiredChunks)
+    ChunkTimeoutExpired(chunk);
+
+  if (!m_invTimeouts.IsEmpty() || !m_chunkTimeouts.IsEmpty())
+    ScheduleTimeoutTick();
+}
+
+
 bool 
 BitcoinNode::ReceivedButNotValidated (std::string blockHash)
 {
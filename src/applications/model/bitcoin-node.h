@@ -6,13 +6,17 @@
 #define BITCOIN_NODE_H
 
 #include <algorithm>
+#include <random>
+#include <chrono>
 #include "ns3/application.h"
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
 #include "ns3/address.h"
+#include "ns3/ipv4-address.h"
 #include "bitcoin.h"
 #include "ns3/boolean.h"
+#include "ns3/random-variable-stream.h"
 #include "../../rapidjson/document.h"
 #include "../../rapidjson/writer.h"
 #include "../../rapidjson/stringbuffer.h"
@@ -23,6 +27,14 @@ class Address;
 class Socket;
 class Packet;
 
+
+/**
+ * Builds a block announcement (INV/HEADERS or EXT_INV/EXT_HEADERS) of the given blocks into a document and returns its size in Bytes.
+ * availableChunks contains the chunks that the node has, or it is nullptr if the node has the full blocks.
+ * BitcoinNode::SelectAnnouncementPolicy picks one instantiation of the compile-time AnnouncementPolicy per node.
+ */
+typedef long (*AnnouncementBuilder) (rapidjson::Document &d, const std::vector<Block> &blocks, const std::vector<int> *availableChunks);
+
  
 class BitcoinNode : public Application 
 {
@@ -35,6 +47,16 @@ public:
   static TypeId GetTypeId (void);
   BitcoinNode (void);
 
+  /**
+   * TracedCallback signatures of the protocol trace sources
+   */
+  typedef void (* BlockTracedCallback) (const blockTrace &block);
+  typedef void (* ChunkTracedCallback) (const chunkTrace &chunk);
+  typedef void (* TimeoutTracedCallback) (const timeoutTrace &timeout);
+  typedef void (* MessageTracedCallback) (const messageTrace &message);
+  typedef void (* HopTracedCallback) (const hopTrace &hop);
+  typedef void (* ReorgTracedCallback) (const reorgTrace &reorg);
+
   virtual ~BitcoinNode (void);
 
   /**
@@ -72,12 +94,26 @@ public:
    * \param internetSpeeds a struct containing the download and upload speed of the node
    */
   void SetNodeInternetSpeeds (const nodeInternetSpeeds &internetSpeeds);
+
+  /**
+   * \brief Set the peers, their speeds and the internet speeds of the node from the shared topology.
+   *        The node keeps a reference to the topology and views its peers' addresses in place, instead of copying them.
+   * \param topology the topology of the network
+   * \param nodeId the id of the node in the topology
+   */
+  void SetTopology (Ptr<const BitcoinTopology> topology, uint32_t nodeId);
   
   /**
    * \brief Set the node statistics
    * \param nodeStats a reference to a nodeStatistics struct
    */
   void SetNodeStats (nodeStatistics *nodeStats);
+
+  /**
+   * \brief Get the node statistics
+   * \return the nodeStatistics struct set with SetNodeStats
+   */
+  nodeStatistics* GetNodeStats (void) const;
   
   /**
    * \brief Set the protocol type(default: STANDARD_PROTOCOL)
@@ -85,6 +121,13 @@ public:
    */
   void SetProtocolType (enum ProtocolType protocolType);
 
+  /**
+   * \brief Assign a fixed random variable stream number to the random variables used by this node
+   * \param stream the first stream index to use
+   * \return the number of stream indices assigned
+   */
+  int64_t AssignStreams (int64_t stream);
+
 protected:
   virtual void DoDispose (void);           // inherited from Application base class.
 
@@ -180,6 +223,20 @@ protected:
    */
   void ValidateOrphanChildren(const Block &newBlock);
 
+  /**
+   * \brief Picks the announcement policy matching m_protocolType and m_blockTorrent. Called once, when the application starts
+   */
+  void SelectAnnouncementPolicy (void);
+
+  /**
+   * \brief Announces a block to the peers, using the selected announcement policy
+   * \param newBlock the announced block
+   * \param availableChunks the chunks of the block that the node has, nullptr if it has the full block. Used only with blockTorrent
+   * \param skipSender true if the peer which sent us the block should not be advertised
+   * \param caller the name of the calling function, used for logging
+   */
+  void AnnounceBlock (const Block &newBlock, const std::vector<int> *availableChunks, bool skipSender, const char *caller);
+
   /**
    * \brief Advertises the newly validated block
    * \param newBlock the new block
@@ -198,6 +255,73 @@ protected:
    */
   void AdvertiseFirstChunk (const Block &newBlock);
 
+  /**
+   * \brief Queues the newly validated block in the pending inventory of every peer (except the one it was received from)
+   *        and arms the peer's trickle timer, if it is not already armed. Used instead of AdvertiseNewBlock/AdvertiseFullBlock
+   *        when m_trickleInv is set.
+   * \param newBlock the new block
+   * \param skipSender true if the peer which sent us the block should not be advertised
+   */
+  void TrickleNewBlock (const Block &newBlock, bool skipSender);
+
+  /**
+   * \brief Called when the trickle timer of a peer expires. Sends all the pending inventory of the peer in a single
+   *        INV/HEADERS (EXT_INV/EXT_HEADERS when blockTorrent is used) message
+   * \param peer the index of the peer
+   */
+  void FlushPendingInv (uint32_t peer);
+
+  /**
+   * \brief Returns the dense local index of a peer. Addresses which are not known yet (e.g. nodes which
+   *        connected to us without being in m_peersAddresses) are appended to the per-peer tables.
+   * \param address the address of the peer
+   * \return the index of the peer in the per-peer tables
+   */
+  uint32_t GetPeerIndex (Ipv4Address address);
+
+  /**
+   * \brief Makes peers the peers of the node and assigns them the indices 0..peers.size() - 1
+   * \param peers the addresses of the peers, which must outlive the node's use of them
+   */
+  void ResetPeers (Span<Ipv4Address> peers);
+
+  /**
+   * \brief Fills the trace record of a block
+   * \param block the block
+   * \return the trace record, with the node which sent the block as peer
+   */
+  blockTrace MakeBlockTrace (const Block &block) const;
+
+  /**
+   * \brief Fires the MessageSent trace
+   * \param message the type of the sent message
+   * \param peer the peer the message was sent to
+   * \param bytes the Bytes written to the socket
+   */
+  void TraceMessageSent (enum Messages message, Ipv4Address peer, uint32_t bytes);
+
+  /**
+   * \brief Starts, or restarts after a timeout, the propagation hop of a block requested with GET_DATA
+   * \param blockHash the block hash
+   * \param peer the peer the GET_DATA or GET_HEADERS is sent to
+   */
+  void RecordBlockRequest (const std::string &blockHash, Ipv4Address peer);
+
+  /**
+   * \brief Adds the delays known when a BLOCK message starts arriving to the propagation hops of its blocks
+   * \param blocks the blocks of the message, as sent by the peer
+   * \param peer the peer which sent the message
+   * \param transmissionTime the time needed to transfer the message over the link
+   * \param downloadQueueingTime the time the message waits behind the blocks which are already being downloaded
+   */
+  void RecordBlockMessage (const rapidjson::Value &blocks, Ipv4Address peer, double transmissionTime, double downloadQueueingTime);
+
+  /**
+   * \brief Completes the propagation hop of a validated block, fires the BlockHop trace and updates the node stats
+   * \param newBlock the validated block
+   */
+  void RecordPropagationHop (const Block &newBlock);
+
   /**
    * \brief Sends a message to a peer
    * \param receivedMessage the type of the received message
@@ -272,6 +396,30 @@ protected:
    */
   void ChunkTimeoutExpired (std::string chunk);
 
+  /**
+   * \brief Arms the timeout of a requested block in m_invTimeouts
+   * \param blockHash the block hash
+   * \param timeout the time after which the timeout expires
+   */
+  void ArmInvTimeout (const std::string &blockHash, Time timeout);
+
+  /**
+   * \brief Arms the timeout of a requested chunk in m_chunkTimeouts
+   * \param chunk the chunk hash
+   * \param timeout the time after which the timeout expires
+   */
+  void ArmChunkTimeout (const std::string &chunk, Time timeout);
+
+  /**
+   * \brief Schedules the next tick of the timeout wheels, if it is not already scheduled
+   */
+  void ScheduleTimeoutTick (void);
+
+  /**
+   * \brief Advances m_invTimeouts and m_chunkTimeouts by one tick and handles the expired timeouts
+   */
+  void TimeoutTick (void);
+
   /**
    * \brief Checks if a block has been received but not been validated yet (if it is included in m_receivedNotValidated)
    * \param blockHash the block hash 
@@ -334,23 +482,26 @@ protected:
   bool            m_isMiner;                          //!< True if the node is also a miner, False otherwise
   double          m_downloadSpeed;                    //!< The download speed of the node in Bytes/s
   double          m_uploadSpeed;                      //!< The upload speed of the node in Bytes/s
-  double          m_averageTransactionSize;           //!< The average transaction size. Needed for compressed blocks
-  int             m_transactionIndexSize;             //!< The transaction index size in bytes. Needed for compressed blocks
   bool            m_blockTorrent;                     //!< True if the blockTorrent mechanism is used, False otherwise
   uint32_t        m_chunkSize;                        //!< The size of the chunk in Bytes, when blockTorrent is used
   bool            m_spv;                              //!< Simplified Payment Verification. Used only in conjuction with blockTorrent
   
-  std::vector<Ipv4Address>                            m_peersAddresses;                 //!< The addresses of peers
-  std::map<Ipv4Address, double>                       m_peersDownloadSpeeds;            //!< The peersDownloadSpeeds of channels
-  std::map<Ipv4Address, double>                       m_peersUploadSpeeds;              //!< The peersUploadSpeeds of channels
-  std::map<Ipv4Address, Ptr<Socket>>                  m_peersSockets;                   //!< The sockets of peers
+  Span<Ipv4Address>                                   m_peersAddresses;                 //!< The addresses of peers, viewing m_topology or m_ownedPeersAddresses
+  std::vector<Ipv4Address>                            m_ownedPeersAddresses;            //!< The addresses of peers, when they are not set from a topology
+  Ptr<const BitcoinTopology>                          m_topology;                       //!< The shared topology, if the peers were set from it
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash> m_peerIndex;              //!< The dense local index of each peer, m_peersAddresses[i] has index i
+  std::vector<double>                                 m_peerDownloadSpeeds;             //!< The download speeds of the peers' channels, indexed by peer index
+  std::vector<double>                                 m_peerUploadSpeeds;               //!< The upload speeds of the peers' channels, indexed by peer index
+  std::vector<Ptr<Socket>>                            m_peerSockets;                    //!< The outgoing sockets of the peers, indexed by peer index
   std::map<std::string, std::vector<Address>>         m_queueInv;                       //!< map holding the addresses of nodes which sent an INV for a particular block
   std::map<std::string, std::vector<Address>>         m_queueChunkPeers;                //!< map holding the addresses of nodes from which we are waiting for a CHUNK, key = block_hash
   std::map<std::string, std::vector<int>>             m_queueChunks;                    //!< map holding the chunks of the blocks which we have not requested yet, key = block_hash
   std::map<std::string, std::vector<int>>             m_receivedChunks;                 //!< map holding the chunks of the blocks which we are currently downloading, key = block_hash
-  std::map<std::string, EventId>                      m_invTimeouts;                    //!< map holding the event timeouts of inv messages
-  std::map<std::string, EventId>                      m_chunkTimeouts;                  //!< map holding the event timeouts of chunk messages
-  std::map<Address, std::string>                      m_bufferedData;                   //!< map holding the buffered data from previous handleRead events
+  TimerWheel                                          m_invTimeouts;                    //!< timer wheel holding the timeouts of inv messages
+  TimerWheel                                          m_chunkTimeouts;                  //!< timer wheel holding the timeouts of chunk messages
+  Time                                                m_timeoutTickInterval;            //!< The tick interval of the timeout wheels
+  EventId                                             m_timeoutTickEvent;               //!< The next tick of the timeout wheels
+  std::vector<std::string>                            m_peerBufferedData;               //!< The buffered data from previous handleRead events, indexed by peer index
   std::map<std::string, Block>                        m_receivedNotValidated;           //!< vector holding the received but not yet validated blocks
   std::map<std::string, Block>                        m_onlyHeadersReceived;            //!< vector holding the blocks that we know but not received
   nodeStatistics                                     *m_nodeStats;                      //!< struct holding the node stats
@@ -359,18 +510,44 @@ protected:
   std::vector<double>                                 m_receiveBlockTimes;              //!< contains the times of the next sendBlock events
   std::vector<double>                                 m_receiveCompressedBlockTimes;    //!< contains the times of the next sendBlock events
   enum ProtocolType                                   m_protocolType;                   //!< protocol type
-
-  const int       m_bitcoinPort;               //!< 8333
-  const int       m_secondsPerMin;             //!< 60
-  const int       m_countBytes;                //!< The size of count variable in messages, 4 Bytes
-  const int       m_bitcoinMessageHeader;      //!< The size of the bitcoin Message Header, 90 Bytes, including both the bitcoinMessageHeaders and the other protocol headers (TCP, IP, Ethernet)
-  const int       m_inventorySizeBytes;        //!< The size of inventories in INV messages, 36 Bytes
-  const int       m_getHeadersSizeBytes;       //!< The size of the GET_HEADERS message, 72 Bytes
-  const int       m_headersSizeBytes;          //!< 81 Bytes
-  const int       m_blockHeadersSizeBytes;     //!< 81 Bytes
+  AnnouncementBuilder                                 m_buildAnnouncement;              //!< Builds the block announcements, specialized for m_protocolType and m_blockTorrent
+  long nodeStatistics::*                              m_announcementSentBytes;          //!< The statistic counting the Bytes of the sent block announcements
+  bool                                                m_trickleInv;                     //!< True if block announcements are batched and trickled to peers, False otherwise
+  Time                                                m_trickleMeanInterval;            //!< The mean of the exponentially distributed per-peer trickle interval
+  std::vector<std::vector<Block>>                     m_peerPendingInv;                 //!< The blocks waiting to be announced to each peer, indexed by peer index
+  std::vector<EventId>                                m_peerTrickleEvents;              //!< The pending trickle event of each peer, indexed by peer index
+  Ptr<ExponentialRandomVariable>                      m_trickleIntervals;               //!< The sampler of the trickle intervals, seeded by RngSeed and RngRun
+  uint32_t                                            m_maxOrphans;                     //!< The maximum number of orphan blocks, 0 for unlimited
+  enum OrphanEvictionPolicy                           m_orphanEvictionPolicy;           //!< The orphan evicted when m_maxOrphans is reached
+  uint32_t                                            m_pruneDepth;                     //!< The number of heights kept below the top block, 0 if pruning is disabled
+  std::map<std::string, pendingHop>                   m_blockHops;                      //!< The propagation hops of the requested blocks which are not validated yet, key = block_hash
+  std::unordered_map<BlockId, double, BlockIdHash>    m_blockValidationTimes;           //!< The time each received block was validated, for the GET_DATA replies
+
+  /**
+   * The protocol constants, taken from the compile-time ProtocolProfile
+   */
+  static constexpr int       m_bitcoinPort = ProtocolProfile::bitcoinPort;                          //!< 8333
+  static constexpr int       m_secondsPerMin = ProtocolProfile::secondsPerMin;                      //!< 60
+  static constexpr int       m_countBytes = ProtocolProfile::countBytes;                            //!< The size of count variable in messages, 4 Bytes
+  static constexpr int       m_bitcoinMessageHeader = ProtocolProfile::bitcoinMessageHeader;        //!< The size of the bitcoin Message Header, 90 Bytes
+  static constexpr int       m_inventorySizeBytes = ProtocolProfile::inventorySizeBytes;            //!< The size of inventories in INV messages, 36 Bytes
+  static constexpr int       m_getHeadersSizeBytes = ProtocolProfile::getHeadersSizeBytes;          //!< The size of the GET_HEADERS message, 72 Bytes
+  static constexpr int       m_headersSizeBytes = ProtocolProfile::headersSizeBytes;                //!< 81 Bytes
+  static constexpr int       m_blockHeadersSizeBytes = ProtocolProfile::blockHeadersSizeBytes;      //!< 81 Bytes
+  static constexpr double    m_averageTransactionSize = ProtocolProfile::averageTransactionSize;    //!< The average transaction size. Needed for compressed blocks
+  static constexpr int       m_transactionIndexSize = ProtocolProfile::transactionIndexSize;        //!< The transaction index size in bytes. Needed for compressed blocks
   
   /// Traced Callback: received packets, source address.
   TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
+  TracedCallback<const blockTrace &>                 m_blockMinedTrace;        //!< A miner generated a block
+  TracedCallback<const blockTrace &>                 m_blockReceivedTrace;     //!< A full block was received, or its last chunk
+  TracedCallback<const blockTrace &>                 m_blockValidatedTrace;    //!< A block was validated and added to the blockchain
+  TracedCallback<const blockTrace &>                 m_orphanAddedTrace;       //!< A block was added to the orphan pool
+  TracedCallback<const timeoutTrace &>               m_timeoutFiredTrace;      //!< An inv or chunk timeout expired
+  TracedCallback<const chunkTrace &>                 m_chunkReceivedTrace;     //!< A chunk was received
+  TracedCallback<const messageTrace &>               m_messageSentTrace;       //!< A message was sent to a peer
+  TracedCallback<const hopTrace &>                   m_blockHopTrace;          //!< A requested block was validated, with the components of its hop
+  TracedCallback<const reorgTrace &>                 m_chainReorgTrace;        //!< The top block was replaced by a block which does not extend it
   
 };
 
@@ -139,7 +139,7 @@ BitcoinSelfishMinerTrials::StartApplication ()    // Called at time specified by
     m_nextBlockSize = m_fixedBlockSize;
   else
   {
-    std::array<double,201> intervals {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 65, 70, 75, 80, 85, 90, 95, 100, 105, 110, 115, 120, 125, 
+    static const std::array<double,201> intervals {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 65, 70, 75, 80, 85, 90, 95, 100, 105, 110, 115, 120, 125, 
                                      130, 135, 140, 145, 150, 155, 160, 165, 170, 175, 180, 185, 190, 195, 200, 205, 210, 215, 220, 225, 230, 235, 
                                      240, 245, 250, 255, 260, 265, 270, 275, 280, 285, 290, 295, 300, 305, 310, 315, 320, 325, 330, 335, 340, 345, 
                                      350, 355, 360, 365, 370, 375, 380, 385, 390, 395, 400, 405, 410, 415, 420, 425, 430, 435, 440, 445, 450, 455, 
@@ -148,7 +148,7 @@ BitcoinSelfishMinerTrials::StartApplication ()    // Called at time specified by
                                      680, 685, 690, 695, 700, 705, 710, 715, 720, 725, 730, 735, 740, 745, 750, 755, 760, 765, 770, 775, 780, 785, 
                                      790, 795, 800, 805, 810, 815, 820, 825, 830, 835, 840, 845, 850, 855, 860, 865, 870, 875, 880, 885, 890, 895, 
                                      900, 905, 910, 915, 920, 925, 930, 935, 940, 945, 950, 955, 960, 965, 970, 975, 980, 985, 990, 995, 1000};
-    std::array<double,200> weights {3.58, 0.33, 0.35, 0.4, 0.38, 0.4, 0.53, 0.46, 0.43, 0.48, 0.56, 0.69, 0.62, 0.62, 0.63, 0.62, 0.62, 0.63, 0.73, 
+    static const std::array<double,200> weights {3.58, 0.33, 0.35, 0.4, 0.38, 0.4, 0.53, 0.46, 0.43, 0.48, 0.56, 0.69, 0.62, 0.62, 0.63, 0.62, 0.62, 0.63, 0.73, 
                                     1.96, 0.75, 0.76, 0.73, 0.64, 0.66, 0.66, 0.66, 0.7, 0.66, 0.73, 0.68, 0.66, 0.67, 0.66, 0.72, 0.68, 0.64, 0.61, 
                                     0.63, 0.58, 0.66, 0.6, 0.7, 0.62, 0.49, 0.59, 0.58, 0.59, 0.63, 1.59, 0.6, 0.58, 0.54, 0.62, 0.55, 0.54, 0.52, 
                                     0.5, 0.53, 0.55, 0.49, 0.47, 0.51, 0.49, 0.52, 0.49, 0.49, 0.49, 0.56, 0.75, 0.51, 0.42, 0.46, 0.47, 0.43, 0.38, 
@@ -160,7 +160,9 @@ BitcoinSelfishMinerTrials::StartApplication ()    // Called at time specified by
                                     0.14, 0.12, 0.14, 0.14, 0.17, 0.15, 0.19, 0.38, 0.2, 0.19, 0.24, 0.26, 0.36, 1.58, 1.49, 0.1, 0.2, 1.98, 0.05, 0.08, 
                                     0.07, 0.07, 0.14, 0.08, 0.08, 0.53, 3.06, 3.31};
                                 
-    m_blockSizeDistribution = std::piecewise_constant_distribution<double> (intervals.begin(), intervals.end(), weights.begin());
+    static const AliasSampler blockSizeSampler (intervals.begin(), intervals.end(), weights.begin());
+                                
+    m_blockSizeSampler = &blockSizeSampler;
   }
   
 /*   if (GetNode()->GetId() == 0)
@@ -179,7 +181,7 @@ void
 BitcoinSelfishMinerTrials::StopApplication ()
 {
   BitcoinNode::StopApplication ();  
-  Simulator::Cancel (m_nextMiningEvent);
+  EventCensus::Cancel (MINE_BLOCK_EVENT, m_nextMiningEvent);
   
   NS_LOG_WARN ("The selfish miner " << GetNode ()->GetId () << " with hash rate = " << m_hashRate << " generated " << m_minerGeneratedBlocks 
                 << " blocks "<< "(" << 100. * m_minerGeneratedBlocks / (m_blockchain.GetTotalBlocks() - 1) 
@@ -205,6 +207,7 @@ void
 BitcoinSelfishMinerTrials::MineBlock (void)  
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (MINE_BLOCK_HANDLER);
   rapidjson::Document d; 
   int height =  m_blockchain.GetCurrentTopBlock()->GetBlockHeight() + 1;
   int minerId = GetNode ()->GetId ();
@@ -251,7 +254,7 @@ BitcoinSelfishMinerTrials::MineBlock (void)
   if (m_fixedBlockSize > 0)
     m_nextBlockSize = m_fixedBlockSize;
   else
-    m_nextBlockSize = m_blockSizeDistribution(m_generator) * 1000 * // *1000 because the m_blockSizeDistribution returns KBytes
+    m_nextBlockSize = m_blockSizeSampler->Sample(m_generator) * 1000 * // *1000 because the m_blockSizeSampler returns KBytes
                       m_averageBlockGenIntervalSeconds / m_realAverageBlockGenIntervalSeconds;	// The block size is linearly dependent on the averageBlockGenIntervalSeconds
 
 
@@ -279,12 +282,12 @@ BitcoinSelfishMinerTrials::MineBlock (void)
   
   if (m_advertiseBlocks == 1)
   {
-    for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+    for (uint32_t i = 0; i < m_peersAddresses.size(); ++i)
     {
 	  const uint8_t delimiter[] = "#";
 
-      m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-	  m_peersSockets[*i]->Send (delimiter, 1, 0);
+      m_peerSockets[i]->Send (reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
+	  m_peerSockets[i]->Send (delimiter, 1, 0);
 	
 /* 	  //Send large packet
 	  int k;
@@ -327,7 +330,7 @@ BitcoinSelfishMinerTrials::ReceivedHigherBlock(const Block &newBlock)
   NS_LOG_WARN (m_winningStreak);
   m_winningStreak = 0;
   m_trials++;
-  Simulator::Cancel (m_nextMiningEvent);
+  EventCensus::Cancel (MINE_BLOCK_EVENT, m_nextMiningEvent);
   ScheduleNextMiningEvent();
 
 }
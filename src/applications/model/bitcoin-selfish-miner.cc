@@ -131,7 +131,7 @@ BitcoinSelfishMiner::StartApplication ()    // Called at time specified by Start
     m_nextBlockSize = m_fixedBlockSize;
   else
   {
-    std::array<double,201> intervals {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 65, 70, 75, 80, 85, 90, 95, 100, 105, 110, 115, 120, 125, 
+    static const std::array<double,201> intervals {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 65, 70, 75, 80, 85, 90, 95, 100, 105, 110, 115, 120, 125, 
                                      130, 135, 140, 145, 150, 155, 160, 165, 170, 175, 180, 185, 190, 195, 200, 205, 210, 215, 220, 225, 230, 235, 
                                      240, 245, 250, 255, 260, 265, 270, 275, 280, 285, 290, 295, 300, 305, 310, 315, 320, 325, 330, 335, 340, 345, 
                                      350, 355, 360, 365, 370, 375, 380, 385, 390, 395, 400, 405, 410, 415, 420, 425, 430, 435, 440, 445, 450, 455, 
@@ -140,7 +140,7 @@ BitcoinSelfishMiner::StartApplication ()    // Called at time specified by Start
                                      680, 685, 690, 695, 700, 705, 710, 715, 720, 725, 730, 735, 740, 745, 750, 755, 760, 765, 770, 775, 780, 785, 
                                      790, 795, 800, 805, 810, 815, 820, 825, 830, 835, 840, 845, 850, 855, 860, 865, 870, 875, 880, 885, 890, 895, 
                                      900, 905, 910, 915, 920, 925, 930, 935, 940, 945, 950, 955, 960, 965, 970, 975, 980, 985, 990, 995, 1000};
-    std::array<double,200> weights {3.58, 0.33, 0.35, 0.4, 0.38, 0.4, 0.53, 0.46, 0.43, 0.48, 0.56, 0.69, 0.62, 0.62, 0.63, 0.62, 0.62, 0.63, 0.73, 
+    static const std::array<double,200> weights {3.58, 0.33, 0.35, 0.4, 0.38, 0.4, 0.53, 0.46, 0.43, 0.48, 0.56, 0.69, 0.62, 0.62, 0.63, 0.62, 0.62, 0.63, 0.73, 
                                     1.96, 0.75, 0.76, 0.73, 0.64, 0.66, 0.66, 0.66, 0.7, 0.66, 0.73, 0.68, 0.66, 0.67, 0.66, 0.72, 0.68, 0.64, 0.61, 
                                     0.63, 0.58, 0.66, 0.6, 0.7, 0.62, 0.49, 0.59, 0.58, 0.59, 0.63, 1.59, 0.6, 0.58, 0.54, 0.62, 0.55, 0.54, 0.52, 
                                     0.5, 0.53, 0.55, 0.49, 0.47, 0.51, 0.49, 0.52, 0.49, 0.49, 0.49, 0.56, 0.75, 0.51, 0.42, 0.46, 0.47, 0.43, 0.38, 
@@ -152,7 +152,9 @@ BitcoinSelfishMiner::StartApplication ()    // Called at time specified by Start
                                     0.14, 0.12, 0.14, 0.14, 0.17, 0.15, 0.19, 0.38, 0.2, 0.19, 0.24, 0.26, 0.36, 1.58, 1.49, 0.1, 0.2, 1.98, 0.05, 0.08, 
                                     0.07, 0.07, 0.14, 0.08, 0.08, 0.53, 3.06, 3.31};
                                 
-    m_blockSizeDistribution = std::piecewise_constant_distribution<double> (intervals.begin(), intervals.end(), weights.begin());
+    static const AliasSampler blockSizeSampler (intervals.begin(), intervals.end(), weights.begin());
+                                
+    m_blockSizeSampler = &blockSizeSampler;
   }
   
 /*   if (GetNode()->GetId() == 0)
@@ -171,7 +173,7 @@ void
 BitcoinSelfishMiner::StopApplication ()
 {
   BitcoinNode::StopApplication ();  
-  Simulator::Cancel (m_nextMiningEvent);
+  EventCensus::Cancel (MINE_BLOCK_EVENT, m_nextMiningEvent);
   
   NS_LOG_WARN ("The selfish miner " << GetNode ()->GetId () << " with hash rate = " << m_hashRate << " generated " << m_minerGeneratedBlocks 
                 << " blocks "<< "(" << 100. * m_minerGeneratedBlocks / (m_blockchain.GetTotalBlocks() - 1) 
@@ -184,18 +186,14 @@ BitcoinSelfishMiner::StopApplication ()
   m_nodeStats->minerAverageBlockGenInterval = m_minerAverageBlockGenInterval;
   m_nodeStats->minerAverageBlockSize = m_minerAverageBlockSize;
   
-  Block b = m_honestNetworkTopBlock;
-  bool stop = false;
-  
-  do
+  std::vector<Block> mainChain = m_blockchain.GetChain(m_honestNetworkTopBlock, m_honestNetworkTopBlock.GetBlockHeight() + 1);
+
+  m_nodeStats->minedBlocksInMainChain += m_blockchain.GetPrunedMainChainBlocks(GetNode()->GetId());
+  for (auto &b : mainChain)
   {
     if (b.GetMinerId() == GetNode()->GetId())
       m_nodeStats->minedBlocksInMainChain++;
-    if (m_blockchain.GetParent(b))
-      b = *(m_blockchain.GetParent(b));
-    else
-      stop = true;
-  }while (!stop);
+  }
 }
 
 void 
@@ -210,6 +208,7 @@ void
 BitcoinSelfishMiner::MineBlock (void)  
 {
   NS_LOG_FUNCTION (this);
+  BITCOIN_PROFILE_HANDLER (MINE_BLOCK_HANDLER);
 
   int height =  m_attackerTopBlock.GetBlockHeight() + 1;
   int minerId = GetNode ()->GetId ();
@@ -240,7 +239,7 @@ BitcoinSelfishMiner::MineBlock (void)
     m_nextBlockSize = m_fixedBlockSize;
   else
   {
-    m_nextBlockSize = m_blockSizeDistribution(m_generator) * 1000;	// *1000 because the m_blockSizeDistribution returns KBytes
+    m_nextBlockSize = m_blockSizeSampler->Sample(m_generator) * 1000;	// *1000 because the m_blockSizeSampler returns KBytes
 
     if (m_cryptocurrency == BITCOIN)
     {
@@ -266,16 +265,7 @@ BitcoinSelfishMiner::MineBlock (void)
   if (m_la == m_maxAttackBlocks)
   {
     NS_LOG_INFO("m_la == m_maxAttackBlocks in MineBlock");
-    std::vector<Block> blocks;
-
-    Block b = m_blockchain.ReturnBlock(m_attackerTopBlock.GetBlockHeight(), GetNode ()->GetId ());
-	  
-    for (int j = 0; j < m_la; j++)
-    {
-      blocks.insert(blocks.begin(), b);
-      if (m_blockchain.GetParent(b))
-        b = *(m_blockchain.GetParent(b));
-    }
+    std::vector<Block> blocks = m_blockchain.GetChain(m_blockchain.ReturnBlock(m_attackerTopBlock.GetBlockHeight(), GetNode ()->GetId ()), m_la);
 	  
     ReleaseChain(blocks);
 	  
@@ -309,16 +299,7 @@ BitcoinSelfishMiner::MineBlock (void)
       case OVERRIDE:
       {
         NS_LOG_INFO("MineBlock: OVERRIDE");
-        std::vector<Block> blocks;
-  
-        Block b = m_blockchain.ReturnBlock(m_honestNetworkTopBlock.GetBlockHeight() + 1, GetNode ()->GetId ());
-	    
-        for (int j = 0; j < m_lh + 1; j++)
-        {
-          blocks.insert(blocks.begin(), b);
-          if (m_blockchain.GetParent(b))
-           b = *(m_blockchain.GetParent(b));
-        }
+        std::vector<Block> blocks = m_blockchain.GetChain(m_blockchain.ReturnBlock(m_honestNetworkTopBlock.GetBlockHeight() + 1, GetNode ()->GetId ()), m_lh + 1);
 	 
         ReleaseChain(blocks);
 	  
@@ -330,16 +311,7 @@ BitcoinSelfishMiner::MineBlock (void)
       case MATCH:
       {
         NS_LOG_INFO("MineBlock: MATCH");
-        std::vector<Block> blocks;
-
-        Block b = m_blockchain.ReturnBlock(m_honestNetworkTopBlock.GetBlockHeight(), GetNode ()->GetId ());
-	  
-        for (int j = 0; j < m_lh; j++)
-        {
-          blocks.insert(blocks.begin(), b);
-		  if (m_blockchain.GetParent(b))
-            b = *(m_blockchain.GetParent(b));
-        }
+        std::vector<Block> blocks = m_blockchain.GetChain(m_blockchain.ReturnBlock(m_honestNetworkTopBlock.GetBlockHeight(), GetNode ()->GetId ()), m_lh);
 	  
         ReleaseChain(blocks);
 
@@ -354,16 +326,7 @@ BitcoinSelfishMiner::MineBlock (void)
       case EXIT:
       {
         NS_LOG_INFO("MineBlock: EXIT");
-        std::vector<Block> blocks;
-
-        Block b = m_blockchain.ReturnBlock(m_attackerTopBlock.GetBlockHeight(), GetNode ()->GetId ());
-	  
-        for (int j = 0; j < m_la; j++)
-        {
-          blocks.insert(blocks.begin(), b);
-		  if (m_blockchain.GetParent(b))
-            b = *(m_blockchain.GetParent(b));
-        }
+        std::vector<Block> blocks = m_blockchain.GetChain(m_blockchain.ReturnBlock(m_attackerTopBlock.GetBlockHeight(), GetNode ()->GetId ()), m_la);
 	  
         ReleaseChain(blocks);
 	  
@@ -416,7 +379,7 @@ BitcoinSelfishMiner::ReceivedHigherBlock(const Block &newBlock)
   NS_LOG_WARN("Bitcoin selfish miner "<< GetNode ()->GetId () << " added a new block in the m_blockchain with higher height: " << newBlock);
 /*   NS_LOG_WARN (m_winningStreak);
   m_winningStreak = 0;
-  Simulator::Cancel (m_nextMiningEvent);
+  EventCensus::Cancel (MINE_BLOCK_EVENT, m_nextMiningEvent);
   ScheduleNextMiningEvent();
  */
 }
@@ -438,11 +401,10 @@ BitcoinSelfishMiner::ReceiveBlock(const Block &newBlock)
   {
     NS_LOG_INFO ("BitcoinSelfishMiner ReceiveBlock: Bitcoin node " << GetNode ()->GetId () << " has already added this block in the m_blockchain: " << newBlock);
     
-    if (m_invTimeouts.find(blockHash) != m_invTimeouts.end())
+    if (m_invTimeouts.IsArmed(blockHash))
     {
       m_queueInv.erase(blockHash);
-      Simulator::Cancel (m_invTimeouts[blockHash]);
-      m_invTimeouts.erase(blockHash);
+      m_invTimeouts.Cancel(blockHash);
     }
   }
   else
@@ -454,8 +416,7 @@ BitcoinSelfishMiner::ReceiveBlock(const Block &newBlock)
 	//PrintInvTimeouts();
 	
     m_queueInv.erase(blockHash);
-    Simulator::Cancel (m_invTimeouts[blockHash]);
-    m_invTimeouts.erase(blockHash);
+    m_invTimeouts.Cancel(blockHash);
 	
     //PrintQueueInv();
 	//PrintInvTimeouts();
@@ -499,23 +460,14 @@ BitcoinSelfishMiner::ReceiveBlock(const Block &newBlock)
         m_la = 0;
         m_lh = 0;
         m_attackerTopBlock = m_honestNetworkTopBlock;
-        Simulator::Cancel (m_nextMiningEvent);
+        EventCensus::Cancel (MINE_BLOCK_EVENT, m_nextMiningEvent);
         ScheduleNextMiningEvent();
         break;
       }
       case OVERRIDE:
       {
         NS_LOG_INFO("ReceiveBlock: OVERRIDE");
-        std::vector<Block> blocks;
-
-        Block b = m_blockchain.ReturnBlock(m_honestNetworkTopBlock.GetBlockHeight() + 1, GetNode ()->GetId ());
-	  
-        for (int j = 0; j < m_lh + 1; j++)
-        {
-          blocks.insert(blocks.begin(), b);
-		  if (m_blockchain.GetParent(b))
-            b = *(m_blockchain.GetParent(b));
-        }
+        std::vector<Block> blocks = m_blockchain.GetChain(m_blockchain.ReturnBlock(m_honestNetworkTopBlock.GetBlockHeight() + 1, GetNode ()->GetId ()), m_lh + 1);
 	 
         ReleaseChain(blocks);
 	  
@@ -527,16 +479,7 @@ BitcoinSelfishMiner::ReceiveBlock(const Block &newBlock)
       case MATCH:
       {
         NS_LOG_INFO("ReceiveBlock: MATCH");
-        std::vector<Block> blocks;
-
-        Block b = m_blockchain.ReturnBlock(m_honestNetworkTopBlock.GetBlockHeight(), GetNode ()->GetId ());
-	  
-        for (int j = 0; j < m_lh; j++)
-        {
-          blocks.insert(blocks.begin(), b);
-		  if (m_blockchain.GetParent(b))
-            b = *(m_blockchain.GetParent(b));        
-        }
+        std::vector<Block> blocks = m_blockchain.GetChain(m_blockchain.ReturnBlock(m_honestNetworkTopBlock.GetBlockHeight(), GetNode ()->GetId ()), m_lh);
 	  
         ReleaseChain(blocks);
 		
@@ -568,7 +511,7 @@ BitcoinSelfishMiner::ReceiveBlock(const Block &newBlock)
 
 
 void 
-BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
+BitcoinSelfishMiner::ReleaseChain(const std::vector<Block> &blocks)
 {
   NS_LOG_FUNCTION (this);
   
@@ -578,66 +521,18 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
   inv.SetObject();
   block.SetObject();
   
+  long invBytes = 0;
+
   switch(m_blockBroadcastType)				  
   {
     case STANDARD:
     {
       rapidjson::Value value;
-      rapidjson::Value array(rapidjson::kArrayType);
-      rapidjson::Value blockInfo(rapidjson::kObjectType);
 
       value.SetString("block"); //Remove
       inv.AddMember("type", value, inv.GetAllocator());
-	  
-      if (m_protocolType == STANDARD_PROTOCOL)
-      {
-        value = INV;
-        inv.AddMember("message", value, inv.GetAllocator());
-  		  
-        for(auto it = blocks.begin(); it != blocks.end(); it++)
-        {
-          std::ostringstream   stringStream;  
-          std::string          blockHash = stringStream.str();
-				
-          stringStream << it->GetBlockHeight() << "/" << it->GetMinerId();
-          blockHash = stringStream.str();
-          value.SetString(blockHash.c_str(), blockHash.size(), inv.GetAllocator());
-          array.PushBack(value, inv.GetAllocator());
-        }
-		
-        inv.AddMember("inv", array, inv.GetAllocator());
-		
-      }
-      else if (m_protocolType == SENDHEADERS)
-      {
-        value = HEADERS;
-        inv.AddMember("message", value, inv.GetAllocator());
-		
-        for(auto it = blocks.begin(); it != blocks.end(); it++)
-        {
-          value = it->GetBlockHeight ();
-          blockInfo.AddMember("height", value, inv.GetAllocator ());
-
-          value = it->GetMinerId ();
-          blockInfo.AddMember("minerId", value, inv.GetAllocator ());
 
-          value = it->GetParentBlockMinerId ();
-          blockInfo.AddMember("parentBlockMinerId", value, inv.GetAllocator ());
-
-          value = it->GetBlockSizeBytes ();
-          blockInfo.AddMember("size", value, inv.GetAllocator ());
-
-          value = it->GetTimeCreated ();
-          blockInfo.AddMember("timeCreated", value, inv.GetAllocator ());
-
-          value = it->GetTimeReceived ();							
-          blockInfo.AddMember("timeReceived", value, inv.GetAllocator ());
-		
-          array.PushBack(blockInfo, inv.GetAllocator());
-        }
-		
-        inv.AddMember("blocks", array, inv.GetAllocator());      
-      }	
+      invBytes = m_buildAnnouncement (inv, blocks, nullptr);
       break;
     }
     case UNSOLICITED:
@@ -681,63 +576,12 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
     case RELAY_NETWORK:
     {
       rapidjson::Value value;
-      rapidjson::Value headersInfo(rapidjson::kObjectType);
-      rapidjson::Value invArray(rapidjson::kArrayType);
       rapidjson::Value blockArray(rapidjson::kArrayType);
 	  
       value.SetString("block"); //Remove
       inv.AddMember("type", value, inv.GetAllocator());
-	  
-      if (m_protocolType == STANDARD_PROTOCOL)
-      {
-
-        value = INV;
-        inv.AddMember("message", value, inv.GetAllocator());
-		  
-        for(auto it = blocks.begin(); it != blocks.end(); it++)
-        {
-          std::ostringstream   stringStream;  
-          std::string          blockHash = stringStream.str();
-				
-          stringStream << it->GetBlockHeight() << "/" << it->GetMinerId();
-          blockHash = stringStream.str();
-          value.SetString(blockHash.c_str(), blockHash.size(), inv.GetAllocator());
-          invArray.PushBack(value, inv.GetAllocator());
-        }
-		
-        inv.AddMember("inv", invArray, inv.GetAllocator()); 
- 
-      }
-      else if (m_protocolType == SENDHEADERS)
-      {
-        value = HEADERS;
-        inv.AddMember("message", value, inv.GetAllocator());
-		
-        for(auto it = blocks.begin(); it != blocks.end(); it++)
-        {
-          value = it->GetBlockHeight ();
-          headersInfo.AddMember("height", value, inv.GetAllocator ());
 
-          value = it->GetMinerId ();
-          headersInfo.AddMember("minerId", value, inv.GetAllocator ());
-
-          value = it->GetParentBlockMinerId ();
-          headersInfo.AddMember("parentBlockMinerId", value, inv.GetAllocator ());
-
-          value = it->GetBlockSizeBytes ();
-          headersInfo.AddMember("size", value, inv.GetAllocator ());
-
-          value = it->GetTimeCreated ();
-          headersInfo.AddMember("timeCreated", value, inv.GetAllocator ());
-
-          value = it->GetTimeReceived ();							
-          headersInfo.AddMember("timeReceived", value, inv.GetAllocator ());
-		  
-          invArray.PushBack(headersInfo, inv.GetAllocator());
-        }
-		
-        inv.AddMember("blocks", invArray, inv.GetAllocator());      
-      }	
+      invBytes = m_buildAnnouncement (inv, blocks, nullptr);
 	  
 	  
 	  
@@ -866,7 +710,7 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
   
   int count = 0;
   
-  for (std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i, ++count)
+  for (Span<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i, ++count)
   {
     
     const uint8_t delimiter[] = "#";
@@ -875,33 +719,10 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
     {
       case STANDARD:
       {
-        m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
-        m_peersSockets[*i]->Send (delimiter, 1, 0);
+        m_peerSockets[count]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
+        m_peerSockets[count]->Send (delimiter, 1, 0);
 		
-        if (m_protocolType == STANDARD_PROTOCOL && !m_blockTorrent)
-          m_nodeStats->invSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
-        else if (m_protocolType == SENDHEADERS && !m_blockTorrent)
-          m_nodeStats->headersSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["blocks"].Size()*m_headersSizeBytes;
-        else if (m_protocolType == STANDARD_PROTOCOL && m_blockTorrent)
-        {
-          m_nodeStats->extInvSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
-          for (int j=0; j<inv["inv"].Size(); j++)
-          {
-            m_nodeStats->extInvSentBytes += 5; //1Byte(fullBlock) + 4Bytes(numberOfChunks)
-            if (!inv["inv"][j]["fullBlock"].GetBool())
-              m_nodeStats->extInvSentBytes += inv["inv"][j]["availableChunks"].Size()*1;
-          }
-        }
-        else if (m_protocolType == SENDHEADERS && m_blockTorrent)
-        {
-          m_nodeStats->extHeadersSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["blocks"].Size()*m_headersSizeBytes;
-          for (int j=0; j<inv["blocks"].Size(); j++)
-          {
-            m_nodeStats->extHeadersSentBytes += 1;//fullBlock
-            if (!inv["blocks"][j]["fullBlock"].GetBool())
-              m_nodeStats->extHeadersSentBytes += inv["inv"][j]["availableChunks"].Size();
-          }	
-        }
+        m_nodeStats->*m_announcementSentBytes += invBytes;
 		
         NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
                      << "s bitcoin miner " << GetNode ()->GetId () 
@@ -922,7 +743,7 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
         double eventTime;	
 				
 /*                 std::cout << "Node " << GetNode()->GetId() << "-" << InetSocketAddress::ConvertFrom(from).GetIpv4 () 
-                          << " " << m_peersDownloadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4 ()] << " Mbps , time = "
+                          << " " << m_peerDownloadSpeeds[count] << " Mbps , time = "
                           << Simulator::Now ().GetSeconds() << "s \n"; */
                 
         if (m_sendBlockTimes.size() == 0 || Simulator::Now ().GetSeconds() >  m_sendBlockTimes.back())
@@ -942,8 +763,8 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
                     << " at " << Simulator::Now ().GetSeconds() + eventTime << "\n");
 
         std::string packet = blockInfo.GetString();
-        Simulator::Schedule (Seconds(eventTime), &BitcoinSelfishMiner::SendBlock, this, packet, m_peersSockets[*i]);
-        Simulator::Schedule (Seconds(eventTime + sendTime), &BitcoinSelfishMiner::RemoveSendTime, this);
+        EventCensus::Schedule (SEND_BLOCK_EVENT, Seconds(eventTime), &BitcoinSelfishMiner::SendBlock, this, packet, m_peerSockets[count]);
+        EventCensus::Schedule (REMOVE_SEND_TIME_EVENT, Seconds(eventTime + sendTime), &BitcoinSelfishMiner::RemoveSendTime, this);
 
         break;
       }
@@ -967,7 +788,7 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
           m_nodeStats->blockSentBytes += m_bitcoinMessageHeader + blockMessageSize;
 			  
 /* 				std::cout << "Node " << GetNode()->GetId() << "-" << *i 
-                            << " " << m_peersDownloadSpeeds[*i] << " Mbps , time = "
+                            << " " << m_peerDownloadSpeeds[count] << " Mbps , time = "
                             << Simulator::Now ().GetSeconds() << "s \n"; */
                 
           if (m_sendCompressedBlockTimes.size() == 0 || Simulator::Now ().GetSeconds() >  m_sendCompressedBlockTimes.back())
@@ -989,39 +810,16 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
           //std::cout << sendTime << std::endl;
 
           std::string packet = blockInfo.GetString();
-          Simulator::Schedule (Seconds(sendTime), &BitcoinSelfishMiner::SendBlock, this, packet, m_peersSockets[*i]);
-          Simulator::Schedule (Seconds(eventTime + sendTime), &BitcoinSelfishMiner::RemoveCompressedBlockSendTime, this);
+          EventCensus::Schedule (SEND_BLOCK_EVENT, Seconds(sendTime), &BitcoinSelfishMiner::SendBlock, this, packet, m_peerSockets[count]);
+          EventCensus::Schedule (REMOVE_COMPRESSED_BLOCK_SEND_TIME_EVENT, Seconds(eventTime + sendTime), &BitcoinSelfishMiner::RemoveCompressedBlockSendTime, this);
 
         }
         else
         {	    
-          m_peersSockets[*i]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
-          m_peersSockets[*i]->Send (delimiter, 1, 0);
+          m_peerSockets[count]->Send (reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
+          m_peerSockets[count]->Send (delimiter, 1, 0);
 	  
-          if (m_protocolType == STANDARD_PROTOCOL && !m_blockTorrent)
-            m_nodeStats->invSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
-          else if (m_protocolType == SENDHEADERS && !m_blockTorrent)
-            m_nodeStats->headersSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["blocks"].Size()*m_headersSizeBytes;
-          else if (m_protocolType == STANDARD_PROTOCOL && m_blockTorrent)
-          {
-            m_nodeStats->extInvSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
-            for (int j=0; j<inv["inv"].Size(); j++)
-            {
-              m_nodeStats->extInvSentBytes += 5; //1Byte(fullBlock) + 4Bytes(numberOfChunks)
-              if (!inv["inv"][j]["fullBlock"].GetBool())
-                m_nodeStats->extInvSentBytes += inv["inv"][j]["availableChunks"].Size()*1;
-            }
-          }
-          else if (m_protocolType == SENDHEADERS && m_blockTorrent)
-          {
-            m_nodeStats->extHeadersSentBytes += m_bitcoinMessageHeader + m_countBytes + inv["blocks"].Size()*m_headersSizeBytes;
-            for (int j=0; j<inv["blocks"].Size(); j++)
-            {
-            m_nodeStats->extHeadersSentBytes += 1;//fullBlock
-            if (!inv["blocks"][j]["fullBlock"].GetBool())
-                m_nodeStats->extHeadersSentBytes += inv["blocks"][j]["availableChunks"].Size()*1;
-            }	
-          }
+          m_nodeStats->*m_announcementSentBytes += invBytes;
 	  
           NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
                        << "s bitcoin miner " << GetNode ()->GetId () 
@@ -1037,7 +835,7 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
         std::string packet;
 			  
 /* 				std::cout << "Node " << GetNode()->GetId() << "-" << *i 
-                            << " " << m_peersDownloadSpeeds[*i] << " Mbps , time = "
+                            << " " << m_peerDownloadSpeeds[count] << " Mbps , time = "
                             << Simulator::Now ().GetSeconds() << "s \n"; */
 							
         if(count < m_noMiners - 1)
@@ -1074,8 +872,8 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
           //std::cout << sendTime << std::endl;
 
           std::string packet = blockInfo.GetString();
-          Simulator::Schedule (Seconds(sendTime), &BitcoinSelfishMiner::SendBlock, this, packet, m_peersSockets[*i]);
-          Simulator::Schedule (Seconds(eventTime + sendTime), &BitcoinSelfishMiner::RemoveCompressedBlockSendTime, this);
+          EventCensus::Schedule (SEND_BLOCK_EVENT, Seconds(sendTime), &BitcoinSelfishMiner::SendBlock, this, packet, m_peerSockets[count]);
+          EventCensus::Schedule (REMOVE_COMPRESSED_BLOCK_SEND_TIME_EVENT, Seconds(eventTime + sendTime), &BitcoinSelfishMiner::RemoveCompressedBlockSendTime, this);
         }
         else
         {
@@ -1103,8 +901,8 @@ BitcoinSelfishMiner::ReleaseChain(std::vector<Block> blocks)
           NS_LOG_INFO("Node " << GetNode()->GetId() << " will send the block to " << *i 
                       << " at " << Simulator::Now ().GetSeconds() + eventTime << ", eventTime = " << eventTime  << "\n");
 
-          Simulator::Schedule (Seconds(eventTime), &BitcoinSelfishMiner::SendBlock, this, packet, m_peersSockets[*i]);
-          Simulator::Schedule (Seconds(eventTime + sendTime), &BitcoinSelfishMiner::RemoveSendTime, this);
+          EventCensus::Schedule (SEND_BLOCK_EVENT, Seconds(eventTime), &BitcoinSelfishMiner::SendBlock, this, packet, m_peerSockets[count]);
+          EventCensus::Schedule (REMOVE_SEND_TIME_EVENT, Seconds(eventTime + sendTime), &BitcoinSelfishMiner::RemoveSendTime, this);
 
         }
 	   break;
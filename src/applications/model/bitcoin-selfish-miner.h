@@ -63,7 +63,7 @@ protected:
    * \brief Called when a new block non-orphan block is received
    * \param newBlock the newly received block
    */
-  void ReleaseChain(std::vector<Block> blocks);	
+  void ReleaseChain(const std::vector<Block> &blocks);	
   
   enum Action ReadActionMatrix(enum ForkType f, int la, int lh);
   
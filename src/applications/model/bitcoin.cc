@@ -9,8 +9,17 @@
 #include "ns3/traced-callback.h"
 #include "ns3/address.h"
 #include "ns3/log.h"
+#include "ns3/fatal-error.h"
+#include "ns3/callback.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include "bitcoin.h"
 
+static double GetWallTime();
 namespace ns3 {
 
 
@@ -29,30 +38,12 @@ Block::Block(int blockHeight, int minerId, int parentBlockMinerId, int blockSize
   m_blockSizeBytes = blockSizeBytes;
   m_timeCreated = timeCreated;
   m_timeReceived = timeReceived;
-  m_receivedFromIpv4 = receivedFromIpv4;
+  m_receivedFromIpv4 = receivedFromIpv4.Get();
 
 }
 
-Block::Block()
+Block::Block() : Block(0, 0, 0, 0, 0, 0, Ipv4Address("0.0.0.0"))
 {  
-  Block(0, 0, 0, 0, 0, 0, Ipv4Address("0.0.0.0"));
-
-}
-
-Block::Block (const Block &blockSource)
-{  
-  m_blockHeight = blockSource.m_blockHeight;
-  m_minerId = blockSource.m_minerId;
-  m_parentBlockMinerId = blockSource.m_parentBlockMinerId;
-  m_blockSizeBytes = blockSource.m_blockSizeBytes;
-  m_timeCreated = blockSource.m_timeCreated;
-  m_timeReceived = blockSource.m_timeReceived;
-  m_receivedFromIpv4 = blockSource.m_receivedFromIpv4;
-
-}
-
-Block::~Block (void)
-{
 }
 
 int 
@@ -119,13 +110,13 @@ Block::GetTimeReceived (void) const
 Ipv4Address 
 Block::GetReceivedFromIpv4 (void) const
 {
-  return m_receivedFromIpv4;
+  return Ipv4Address(m_receivedFromIpv4);
 }
   
 void 
 Block::SetReceivedFromIpv4 (Ipv4Address receivedFromIpv4)
 {
-  m_receivedFromIpv4 = receivedFromIpv4;
+  m_receivedFromIpv4 = receivedFromIpv4.Get();
 }
 
 bool 
@@ -146,21 +137,6 @@ Block::IsChild(const Block &block) const
     return false;
 }
 
-
-Block& 
-Block::operator= (const Block &blockSource)
-{  
-  m_blockHeight = blockSource.m_blockHeight;
-  m_minerId = blockSource.m_minerId;
-  m_parentBlockMinerId = blockSource.m_parentBlockMinerId;
-  m_blockSizeBytes = blockSource.m_blockSizeBytes;
-  m_timeCreated = blockSource.m_timeCreated;
-  m_timeReceived = blockSource.m_timeReceived;
-  m_receivedFromIpv4 = blockSource.m_receivedFromIpv4;
-
-  return *this;
-}
-
 /**
  *
  * Class BitcoinChunk functions
@@ -175,26 +151,8 @@ BitcoinChunk::BitcoinChunk(int blockHeight, int minerId, int chunkId, int parent
   m_chunkId = chunkId;
 }
 
-BitcoinChunk::BitcoinChunk()
-{  
-  BitcoinChunk(0, 0, 0, 0, 0, 0, 0, Ipv4Address("0.0.0.0"));
-}
-
-BitcoinChunk::BitcoinChunk (const BitcoinChunk &chunkSource)
+BitcoinChunk::BitcoinChunk() : BitcoinChunk(0, 0, 0, 0, 0, 0, 0, Ipv4Address("0.0.0.0"))
 {  
-  m_blockHeight = chunkSource.m_blockHeight;
-  m_minerId = chunkSource.m_minerId;
-  m_chunkId = chunkSource.m_chunkId;
-  m_parentBlockMinerId = chunkSource.m_parentBlockMinerId;
-  m_blockSizeBytes = chunkSource.m_blockSizeBytes;
-  m_timeCreated = chunkSource.m_timeCreated;
-  m_timeReceived = chunkSource.m_timeReceived;
-  m_receivedFromIpv4 = chunkSource.m_receivedFromIpv4;
-
-}
-
-BitcoinChunk::~BitcoinChunk (void)
-{
 }
 
 int 
@@ -209,32 +167,38 @@ BitcoinChunk::SetChunkId (int chunkId)
   m_chunkId = chunkId;
 }
 
-BitcoinChunk& 
-BitcoinChunk::operator= (const BitcoinChunk &chunkSource)
-{  
-  m_blockHeight = chunkSource.m_blockHeight;
-  m_minerId = chunkSource.m_minerId;
-  m_chunkId = chunkSource.m_chunkId;
-  m_parentBlockMinerId = chunkSource.m_parentBlockMinerId;
-  m_blockSizeBytes = chunkSource.m_blockSizeBytes;
-  m_timeCreated = chunkSource.m_timeCreated;
-  m_timeReceived = chunkSource.m_timeReceived;
-  m_receivedFromIpv4 = chunkSource.m_receivedFromIpv4;
-
-  return *this;
-}
-
-
 /**
  *
  * Class Blockchain functions
  *
  */
  
+/**
+ * Clears the lowest set bit of n
+ */
+static int 
+InvertLowestOne (int n)
+{
+  return n & (n - 1);
+}
+
+ 
 Blockchain::Blockchain(void)
 {
   m_noStaleBlocks = 0;
   m_totalBlocks = 0;
+  m_blocksInForks = 0;
+  m_longestForkSize = 0;
+  m_noReorgs = 0;
+  m_maxReorgDepth = 0;
+  m_lastReorgDepth = 0;
+  m_maxOrphans = 0;
+  m_orphanEvictionPolicy = EVICT_OLDEST;
+  m_orphansResolved = 0;
+  m_orphansEvicted = 0;
+  m_pruneDepth = 0;
+  m_prunedHeight = 0;
+  m_prunedBlocks = 0;
   Block genesisBlock(0, -1, -2, 0, 0, 0, Ipv4Address("0.0.0.0"));
   AddBlock(genesisBlock); 
 }
@@ -273,7 +237,13 @@ bool
 Blockchain::HasBlock (const Block &newBlock) const
 {
   
-  if (newBlock.GetBlockHeight() > GetCurrentTopBlock()->GetBlockHeight())
+  if (IsPruned(newBlock.GetBlockHeight()))
+  {
+    /* The block is too deep below the top block to affect the blockchain, so it is treated as known. */
+
+    return true;
+  }
+  else if (newBlock.GetBlockHeight() > GetCurrentTopBlock()->GetBlockHeight())
   {
     /* The new block has a new blockHeight, so we haven't received it previously. */
 	
@@ -283,7 +253,7 @@ Blockchain::HasBlock (const Block &newBlock) const
   {															
     /*  The new block doesn't have a new blockHeight, so we have to check it is new or if we have already received it. */
 	
-    for (auto const &block: m_blocks[newBlock.GetBlockHeight()]) 
+    for (auto const &block: GetRow(newBlock.GetBlockHeight())) 
     {
       if (block == newBlock)
 	  {
@@ -298,7 +268,13 @@ bool
 Blockchain::HasBlock (int height, int minerId) const
 {
   
-  if (height > GetCurrentTopBlock()->GetBlockHeight())		
+  if (IsPruned(height))
+  {
+    /* The block is too deep below the top block to affect the blockchain, so it is treated as known. */
+
+    return true;
+  }
+  else if (height > GetCurrentTopBlock()->GetBlockHeight())		
   {
     /* The new block has a new blockHeight, so we haven't received it previously. */
 	
@@ -308,7 +284,7 @@ Blockchain::HasBlock (int height, int minerId) const
   {															
     /*  The new block doesn't have a new blockHeight, so we have to check it is new or if we have already received it. */
 	
-    for (auto const &block: m_blocks[height]) 
+    for (auto const &block: GetRow(height)) 
     {
       if (block.GetBlockHeight() == height && block.GetMinerId() == minerId)
 	  {
@@ -325,20 +301,19 @@ Blockchain::ReturnBlock(int height, int minerId)
 {
   std::vector<Block>::iterator  block_it;
 
-  if (height <= GetBlockchainHeight() && height >= 0)
+  if (height <= GetBlockchainHeight() && height >= m_prunedHeight)
   {
-    for (block_it = m_blocks[height].begin();  block_it < m_blocks[height].end(); block_it++)
+    for (block_it = GetRow(height).begin();  block_it < GetRow(height).end(); block_it++)
     {
       if (block_it->GetBlockHeight() == height && block_it->GetMinerId() == minerId)
         return *block_it;
     }
   }
   
-  for (block_it = m_orphans.begin();  block_it < m_orphans.end(); block_it++)
-  {
-    if (block_it->GetBlockHeight() == height && block_it->GetMinerId() == minerId)
-      return *block_it;
-  }
+  auto orphan_it = m_orphanIndex.find(BlockId(height, minerId));
+
+  if (orphan_it != m_orphanIndex.end())
+    return *(orphan_it->second);
   
   return Block(-1, -1, -1, -1, -1, -1, Ipv4Address("0.0.0.0"));
 }
@@ -347,36 +322,24 @@ Blockchain::ReturnBlock(int height, int minerId)
 bool 
 Blockchain::IsOrphan (const Block &newBlock) const
 {													
-  for (auto const &block: m_orphans) 
-  {
-    if (block == newBlock)
-    {
-      return true;
-    }
-  }
-  return false;
+  return IsOrphan(newBlock.GetBlockHeight(), newBlock.GetMinerId());
 }
 
 
 bool 
 Blockchain::IsOrphan (int height, int minerId) const
 {													
-  for (auto const &block: m_orphans) 
-  {
-    if (block.GetBlockHeight() == height && block.GetMinerId() == minerId)
-    {
-      return true;
-    }
-  }
-  return false;
+  return m_orphanIndex.find(BlockId(height, minerId)) != m_orphanIndex.end();
 }
 
 
 const Block* 
 Blockchain::GetBlockPointer (const Block &newBlock) const
 {
+  if (newBlock.GetBlockHeight() < m_prunedHeight || newBlock.GetBlockHeight() > GetBlockchainHeight())
+    return nullptr;
   
-  for (auto const &block: m_blocks[newBlock.GetBlockHeight()]) 
+  for (auto const &block: GetRow(newBlock.GetBlockHeight())) 
   {
     if (block == newBlock)
     {
@@ -393,10 +356,10 @@ Blockchain::GetChildrenPointers (const Block &block)
   std::vector<Block>::iterator  block_it;
   int childrenHeight = block.GetBlockHeight() + 1;
   
-  if (childrenHeight > GetBlockchainHeight())
+  if (childrenHeight > GetBlockchainHeight() || childrenHeight < m_prunedHeight)
     return children;
 
-  for (block_it = m_blocks[childrenHeight].begin();  block_it < m_blocks[childrenHeight].end(); block_it++)
+  for (block_it = GetRow(childrenHeight).begin();  block_it < GetRow(childrenHeight).end(); block_it++)
   {
     if (block.IsParent(*block_it))
     {
@@ -411,14 +374,11 @@ const std::vector<const Block *>
 Blockchain::GetOrphanChildrenPointers (const Block &newBlock)
 {
   std::vector<const Block *> children;
-  std::vector<Block>::iterator  block_it;
+  auto range = m_orphansByParent.equal_range(BlockId(newBlock.GetBlockHeight(), newBlock.GetMinerId()));
 
-  for (block_it = m_orphans.begin();  block_it < m_orphans.end(); block_it++)
+  for (auto it = range.first; it != range.second; it++)
   {
-    if (newBlock.IsParent(*block_it))
-    {
-      children.push_back(&(*block_it));
-    }
+    children.push_back(&(*it->second));
   }
   return children;
 }
@@ -430,10 +390,10 @@ Blockchain::GetParent (const Block &block)
   std::vector<Block>::iterator  block_it;
   int parentHeight = block.GetBlockHeight() - 1;
 
-  if (parentHeight > GetBlockchainHeight() || parentHeight < 0)
+  if (parentHeight > GetBlockchainHeight() || parentHeight < m_prunedHeight)
     return nullptr;
   
-  for (block_it = m_blocks[parentHeight].begin();  block_it < m_blocks[parentHeight].end(); block_it++)  {
+  for (block_it = GetRow(parentHeight).begin();  block_it < GetRow(parentHeight).end(); block_it++)  {
     if (block.IsChild(*block_it))
     {
       return &(*block_it);
@@ -447,21 +407,67 @@ Blockchain::GetParent (const Block &block)
 const Block* 
 Blockchain::GetCurrentTopBlock (void) const
 {
-  return &m_blocks[m_blocks.size() - 1][0];
+  return &m_blocks.back()[0];
 }
 
 
 void 
 Blockchain::AddBlock (const Block& newBlock)
 {
+  int index;
+  int parentIndex = GetParentIndex(newBlock);
+  int height = newBlock.GetBlockHeight();
+
+  if (IsPruned(height))
+  {
+    /**
+     * The height has been pruned, so the block can only be a stale block in a fork.
+     * It is counted like a block added to an existing row.
+     */
+    int rowSize = GetPrunedRowSize(height);
+
+    if (rowSize > 0)
+      m_noStaleBlocks++;
+    if (rowSize == 1)
+      m_blocksInForks += 2;
+    else if (rowSize > 1)
+      m_blocksInForks++;
+
+    if (m_prunedRowSizes.size() <= static_cast<size_t>(height))
+      m_prunedRowSizes.resize(height + 1, 0);
+    m_prunedRowSizes[height]++;
+    m_totalBlocks++;
+    return;
+  }
 
   if (m_blocks.size() == 0)
   {
     std::vector<Block> newHeight(1, newBlock);
 	m_blocks.push_back(newHeight);
+    m_index.push_back(std::vector<BlockIndexEntry> ());
+    index = 0;
   }	
   else if (newBlock.GetBlockHeight() > GetCurrentTopBlock()->GetBlockHeight())   		
   {
+    /**
+     * The new block becomes the top block. If it does not extend the current top block, the blocks
+     * of the current main chain down to the common ancestor leave the main chain.
+     */
+    const Block *oldTop = GetCurrentTopBlock();
+
+    if (parentIndex >= 0 && !oldTop->IsParent(newBlock))
+    {
+      const Block *ancestor = GetCommonAncestor(GetRow(height - 1)[parentIndex], *oldTop);
+
+      if (ancestor != nullptr)
+      {
+        m_noReorgs++;
+        m_lastReorgDepth = oldTop->GetBlockHeight() - ancestor->GetBlockHeight();
+        if (m_lastReorgDepth > m_maxReorgDepth)
+          m_maxReorgDepth = m_lastReorgDepth;
+      }
+    }
+
     /**
      * The new block has a new blockHeight, so have to create a new vector (row)
      * If we receive an orphan block we have to create the dummy rows for the missing blocks as well
@@ -472,63 +478,220 @@ Blockchain::AddBlock (const Block& newBlock)
     {  
       std::vector<Block> newHeight; 
       m_blocks.push_back(newHeight);
+      m_index.push_back(std::vector<BlockIndexEntry> ());
     }
 	
     std::vector<Block> newHeight(1, newBlock);
     m_blocks.push_back(newHeight);
+    m_index.push_back(std::vector<BlockIndexEntry> ());
+    index = 0;
   }
   else
   {
     /* The new block doesn't have a new blockHeight, so we have to add it in an existing row */
-	
-    if (m_blocks[newBlock.GetBlockHeight()].size() > 0)
+    if (GetRow(height).size() > 0)
       m_noStaleBlocks++;									
 
-    m_blocks[newBlock.GetBlockHeight()].push_back(newBlock);   
+    /**
+     * The row becomes a fork with its second block; every other block adds one more block in forks.
+     */
+    if (GetRow(height).size() == 1)
+      m_blocksInForks += 2;
+    else if (GetRow(height).size() > 1)
+      m_blocksInForks++;
+
+    GetRow(height).push_back(newBlock);   
+    index = GetRow(height).size() - 1;
+  }
+
+  /**
+   * Index the new block. The skip ancestor is found through the parent, whose skip pointers are already set.
+   */
+  BlockIndexEntry entry;
+  entry.parent = parentIndex;
+  entry.skip = parentIndex >= 0 ? GetAncestorIndex(height - 1, parentIndex, GetSkipHeight(height)) : -1;
+  entry.forkLength = -1;
+  GetIndexRow(height).push_back(entry);
+
+  /**
+   * Blocks added before their parent get linked to it now, along with the skip pointers of their descendants
+   */
+  if (height + 1 <= GetBlockchainHeight())
+  {
+    for (int i = 0; i < GetRow(height + 1).size(); i++)
+    {
+      if (GetIndexRow(height + 1)[i].parent < 0 && newBlock.IsParent(GetRow(height + 1)[i]))
+      {
+        GetIndexRow(height + 1)[i].parent = index;
+        UpdateSkipIndex(height + 1, i);
+      }
+    }
   }
+
+  /**
+   * The first sibling of the row is now in a fork as well
+   */
+  if (GetRow(height).size() == 2)
+    UpdateForkLength(height, 0);
   
+  UpdateForkLength(height, index);
   m_totalBlocks++;
+
+  if (m_pruneDepth > 0)
+    Prune();
 }
 
 
 void 
-Blockchain::AddOrphan (const Block& newBlock)
+Blockchain::SetPruneDepth (int pruneDepth)
+{
+  m_pruneDepth = pruneDepth;
+}
+
+
+int 
+Blockchain::GetPrunedHeight (void) const
+{
+  return m_prunedHeight;
+}
+
+
+int 
+Blockchain::GetPrunedMainChainBlocks (int minerId) const
 {
-  m_orphans.push_back(newBlock);
+  auto it = m_prunedMainChainBlocks.find(minerId);
+
+  return it != m_prunedMainChainBlocks.end() ? it->second : 0;
 }
 
 
 void 
-Blockchain::RemoveOrphan (const Block& newBlock)
+Blockchain::Prune (void)
 {
-  std::vector<Block>::iterator  block_it;
+  const Block *top = GetCurrentTopBlock();
 
-  for (block_it = m_orphans.begin();  block_it < m_orphans.end(); block_it++)
+  while (m_prunedHeight < top->GetBlockHeight() - m_pruneDepth)
   {
-    if (newBlock == *block_it)
-      break;
+    /**
+     * Keep only the summary of the row: its blocks and the miner of its main chain block.
+     * The stale and fork counters are already maintained incrementally.
+     */
+    const Block *mainChainBlock = GetAncestor(*top, m_prunedHeight);
+
+    if (mainChainBlock != nullptr)
+      m_prunedMainChainBlocks[mainChainBlock->GetMinerId()]++;
+    m_prunedBlocks += m_blocks.front().size();
+    if (m_prunedRowSizes.size() <= static_cast<size_t>(m_prunedHeight))
+      m_prunedRowSizes.resize(m_prunedHeight + 1, 0);
+    m_prunedRowSizes[m_prunedHeight] += m_blocks.front().size();
+
+    m_blocks.pop_front();
+    m_index.pop_front();
+    m_prunedHeight++;
   }
-  
-  if (block_it == m_orphans.end())
+}
+
+
+int 
+Blockchain::GetPrunedRowSize (int height) const
+{
+  int rowSize = height < static_cast<int>(m_prunedRowSizes.size()) ? m_prunedRowSizes[height] : 0;
+
+  if (height >= m_prunedHeight && height <= GetBlockchainHeight())
+    rowSize += GetRow(height).size();
+  return rowSize;
+}
+
+
+void 
+Blockchain::SetOrphanPoolLimits (int maxOrphans, enum OrphanEvictionPolicy evictionPolicy)
+{
+  m_maxOrphans = maxOrphans;
+  m_orphanEvictionPolicy = evictionPolicy;
+}
+
+
+Block 
+Blockchain::AddOrphan (const Block& newBlock)
+{
+  Block evicted(-1, -1, -1, -1, -1, -1, Ipv4Address("0.0.0.0"));
+
+  if (IsOrphan(newBlock))
+    return evicted;
+
+  if (m_maxOrphans > 0 && m_orphans.size() >= m_maxOrphans)
   {
-    // name not in vector
+    m_orphansEvicted++;
+
+    if (m_orphanEvictionPolicy == EVICT_NEWEST)
+      return newBlock;
+
+    evicted = m_orphans.front();
+    EraseOrphan(m_orphans.begin());
+  }
+
+  auto it = m_orphans.insert(m_orphans.end(), newBlock);
+
+  m_orphanIndex[BlockId(newBlock.GetBlockHeight(), newBlock.GetMinerId())] = it;
+  m_orphansByParent.insert(std::make_pair(BlockId(newBlock.GetBlockHeight() - 1, newBlock.GetParentBlockMinerId()), it));
+  return evicted;
+}
+
+
+void 
+Blockchain::RemoveOrphan (const Block& newBlock)
+{
+  auto orphan_it = m_orphanIndex.find(BlockId(newBlock.GetBlockHeight(), newBlock.GetMinerId()));
+
+  if (orphan_it == m_orphanIndex.end())
     return;
-  } 
-  else
+
+  m_orphansResolved++;
+  EraseOrphan(orphan_it->second);
+}
+
+
+void 
+Blockchain::EraseOrphan (std::list<Block>::iterator it)
+{
+  auto range = m_orphansByParent.equal_range(BlockId(it->GetBlockHeight() - 1, it->GetParentBlockMinerId()));
+
+  for (auto parent_it = range.first; parent_it != range.second; parent_it++)
   {
-    m_orphans.erase(block_it);
+    if (parent_it->second == it)
+    {
+      m_orphansByParent.erase(parent_it);
+      break;
+    }
   }
+
+  m_orphanIndex.erase(BlockId(it->GetBlockHeight(), it->GetMinerId()));
+  m_orphans.erase(it);
+}
+
+
+long 
+Blockchain::GetOrphansResolved (void) const
+{
+  return m_orphansResolved;
+}
+
+
+long 
+Blockchain::GetOrphansEvicted (void) const
+{
+  return m_orphansEvicted;
 }
 
 
 void
 Blockchain::PrintOrphans (void)
 {
-  std::vector<Block>::iterator  block_it;
+  std::list<Block>::iterator  block_it;
   
   std::cout << "The orphans are:\n";
   
-  for (block_it = m_orphans.begin();  block_it < m_orphans.end(); block_it++)
+  for (block_it = m_orphans.begin();  block_it != m_orphans.end(); block_it++)
   {
     std::cout << *block_it << "\n";
   }
@@ -538,157 +701,1245 @@ Blockchain::PrintOrphans (void)
 
 
 int 
-Blockchain::GetBlocksInForks (void)
+Blockchain::GetBlocksInForks (void) const
 {
-  std::vector< std::vector<Block>>::iterator blockHeight_it;
-  int count = 0;
-  
-  for (blockHeight_it = m_blocks.begin(); blockHeight_it < m_blocks.end(); blockHeight_it++) 
-  {
-    if (blockHeight_it->size() > 1)
-      count += blockHeight_it->size();
-  }
-  
-  return count;
+  return m_blocksInForks;
 }
 
 
 int 
-Blockchain::GetLongestForkSize (void)
+Blockchain::GetLongestForkSize (void) const
 {
-  std::vector< std::vector<Block>>::iterator   blockHeight_it;
-  std::vector<Block>::iterator                 block_it;
-  std::map<int, int>                           forkedBlocksParentId;
-  std::vector<int>                             newForks; 
-  int maxSize = 0;
-  
-  for (blockHeight_it = m_blocks.begin(); blockHeight_it < m_blocks.end(); blockHeight_it++) 
-  {
-	
-    if (blockHeight_it->size() > 1 && forkedBlocksParentId.size() == 0)
-    {
-      for (block_it = blockHeight_it->begin();  block_it < blockHeight_it->end(); block_it++)
-      {
-        forkedBlocksParentId[block_it->GetMinerId()] = 1;
-      }
-    }
-    else if (blockHeight_it->size() > 1)
-    {
-      for (block_it = blockHeight_it->begin();  block_it < blockHeight_it->end(); block_it++)
-      {
-        std::map<int, int>::iterator mapIndex = forkedBlocksParentId.find(block_it->GetParentBlockMinerId());
-        
-        if(mapIndex != forkedBlocksParentId.end())
-        {
-          forkedBlocksParentId[block_it->GetMinerId()] = mapIndex->second + 1;
-          if(block_it->GetMinerId() != mapIndex->first)
-            forkedBlocksParentId.erase(mapIndex);	
-          newForks.push_back(block_it->GetMinerId());		  
-        }
-        else
-        {
-          forkedBlocksParentId[block_it->GetMinerId()] = 1;
-        }		  
-      }
-	  
-      for (auto &block : forkedBlocksParentId)
-      {
-       if (std::find(newForks.begin(), newForks.end(), block.first) == newForks.end() )
-       {
-         if(block.second > maxSize)
-           maxSize = block.second;
-         forkedBlocksParentId.erase(block.first);
-       }
-	  }
-    }
-    else if (blockHeight_it->size() == 1 && forkedBlocksParentId.size() > 0)
-    {
+  return m_longestForkSize;
+}
 
-      for (auto &block : forkedBlocksParentId)
-      {
-        if(block.second > maxSize)
-          maxSize = block.second;
-      }
-	
-      forkedBlocksParentId.clear();
-    }
-  }
-  
-  for (auto &block : forkedBlocksParentId)
-  {
-    if(block.second > maxSize)
-      maxSize = block.second;
-  }
-   
-  return maxSize;
+
+int 
+Blockchain::GetNoStaleBlocks (int height) const
+{
+  if (height < m_prunedHeight || height > GetBlockchainHeight() || GetRow(height).size() == 0)
+    return 0;
+
+  return GetRow(height).size() - 1;
 }
 
 
-bool operator== (const Block &block1, const Block &block2)
+int 
+Blockchain::GetNoReorgs (void) const
 {
-  if (block1.GetBlockHeight() == block2.GetBlockHeight() && block1.GetMinerId() == block2.GetMinerId())
-    return true;
-  else
-    return false;
+  return m_noReorgs;
 }
 
-bool operator== (const BitcoinChunk &chunk1, const BitcoinChunk &chunk2)
+
+int 
+Blockchain::GetMaxReorgDepth (void) const
 {
-  if (chunk1.GetBlockHeight() == chunk2.GetBlockHeight() && chunk1.GetMinerId() == chunk2.GetMinerId() && chunk1.GetChunkId() == chunk2.GetChunkId())
-    return true;
-  else
-    return false;
+  return m_maxReorgDepth;
 }
 
-bool operator< (const BitcoinChunk &chunk1, const BitcoinChunk &chunk2)
+
+int
+Blockchain::GetLastReorgDepth (void) const
 {
-  if (chunk1.GetBlockHeight() < chunk2.GetBlockHeight())
-    return true;
-  else if (chunk1.GetBlockHeight() == chunk2.GetBlockHeight() && chunk1.GetMinerId() < chunk2.GetMinerId())
-    return true;
-  else if (chunk1.GetBlockHeight() == chunk2.GetBlockHeight() && chunk1.GetMinerId() == chunk2.GetMinerId() && chunk1.GetChunkId() < chunk2.GetChunkId())
-    return true;
-  else
-    return false;
+  return m_lastReorgDepth;
 }
 
-std::ostream& operator<< (std::ostream &out, const Block &block)
+
+const Block* 
+Blockchain::GetAncestor (const Block &block, int height) const
 {
+  int index = GetIndex(block);
 
-    out << "(m_blockHeight: " << block.GetBlockHeight() << ", " <<
-        "m_minerId: " << block.GetMinerId() << ", " <<
-        "m_parentBlockMinerId: " << block.GetParentBlockMinerId() << ", " <<
-        "m_blockSizeBytes: " << block.GetBlockSizeBytes() << ", " <<
-        "m_timeCreated: " << block.GetTimeCreated() << ", " <<
-        "m_timeReceived: " << block.GetTimeReceived() << ", " <<
-        "m_receivedFromIpv4: " << block.GetReceivedFromIpv4() <<
-        ")";
-    return out;
+  if (index < 0)
+    return nullptr;
+
+  int ancestorIndex = GetAncestorIndex(block.GetBlockHeight(), index, height);
+
+  if (ancestorIndex < 0)
+    return nullptr;
+
+  return &GetRow(height)[ancestorIndex];
 }
 
-std::ostream& operator<< (std::ostream &out, const BitcoinChunk &chunk)
+
+const Block* 
+Blockchain::GetCommonAncestor (const Block &block1, const Block &block2) const
 {
+  int index1 = GetIndex(block1);
+  int index2 = GetIndex(block2);
+  int height = std::min(block1.GetBlockHeight(), block2.GetBlockHeight());
 
-    out << "(m_blockHeight: " << chunk.GetBlockHeight() << ", " <<
-        "m_minerId: " << chunk.GetMinerId() << ", " <<
-        "chunkId: " << chunk.GetChunkId() << ", " <<
-        "m_parentBlockMinerId: " << chunk.GetParentBlockMinerId() << ", " <<
-        "m_blockSizeBytes: " << chunk.GetBlockSizeBytes() << ", " <<
-        "m_timeCreated: " << chunk.GetTimeCreated() << ", " <<
-        "m_timeReceived: " << chunk.GetTimeReceived() << ", " <<
-        "m_receivedFromIpv4: " << chunk.GetReceivedFromIpv4() <<
-        ")";
-    return out;
+  if (index1 < 0 || index2 < 0)
+    return nullptr;
+
+  /**
+   * Bring both blocks to the same height through the skip pointers and then walk down together
+   */
+  index1 = GetAncestorIndex(block1.GetBlockHeight(), index1, height);
+  index2 = GetAncestorIndex(block2.GetBlockHeight(), index2, height);
+
+  while (index1 >= 0 && index2 >= 0 && index1 != index2)
+  {
+    if (height - 1 < m_prunedHeight)
+      return nullptr;
+
+    index1 = GetIndexRow(height)[index1].parent;
+    index2 = GetIndexRow(height)[index2].parent;
+    height--;
+  }
+
+  if (index1 < 0 || index2 < 0)
+    return nullptr;
+
+  return &GetRow(height)[index1];
 }
 
-std::ostream& operator<< (std::ostream &out, Blockchain &blockchain)
+
+bool 
+Blockchain::IsInChain (const Block &block, const Block &top) const
 {
-  
-  std::vector< std::vector<Block>>::iterator blockHeight_it;
-  std::vector<Block>::iterator  block_it;
+  if (block.GetBlockHeight() > top.GetBlockHeight())
+    return false;
+
+  const Block *ancestor = GetAncestor(top, block.GetBlockHeight());
+
+  return ancestor != nullptr && *ancestor == block;
+}
+
+
+bool 
+Blockchain::IsInMainChain (const Block &block) const
+{
+  return IsInChain(block, *GetCurrentTopBlock());
+}
+
+
+std::vector<Block> 
+Blockchain::GetChain (const Block &top, int noBlocks) const
+{
+  std::vector<Block> chain;
+  int height = top.GetBlockHeight();
+  int index = GetIndex(top);
+
+  chain.reserve(noBlocks);
+  while (index >= 0 && chain.size() < noBlocks)
+  {
+    chain.push_back(GetRow(height)[index]);
+    index = height - 1 >= m_prunedHeight ? GetIndexRow(height)[index].parent : -1;
+    height--;
+  }
+
+  std::reverse(chain.begin(), chain.end());
+  return chain;
+}
+
+
+int 
+Blockchain::GetSkipHeight (int height)
+{
+  if (height < 2)
+    return 0;
+
+  /**
+   * Odd heights skip a bit less far than even ones, so that consecutive blocks cover exponentially
+   * growing distances with a bounded number of hops in between.
+   */
+  return (height & 1) ? InvertLowestOne(InvertLowestOne(height - 1)) + 1 : InvertLowestOne(height);
+}
+
+
+int 
+Blockchain::GetIndex (const Block &block) const
+{
+  int height = block.GetBlockHeight();
+
+  if (height < m_prunedHeight || height > GetBlockchainHeight())
+    return -1;
+
+  for (int i = 0; i < GetRow(height).size(); i++)
+  {
+    if (block == GetRow(height)[i])
+      return i;
+  }
+  return -1;
+}
+
+
+int 
+Blockchain::GetParentIndex (const Block &block) const
+{
+  int parentHeight = block.GetBlockHeight() - 1;
+
+  if (parentHeight < m_prunedHeight || parentHeight > GetBlockchainHeight())
+    return -1;
+
+  for (int i = 0; i < GetRow(parentHeight).size(); i++)
+  {
+    if (block.IsChild(GetRow(parentHeight)[i]))
+      return i;
+  }
+  return -1;
+}
+
+
+int 
+Blockchain::GetAncestorIndex (int height, int index, int ancestorHeight) const
+{
+  if (ancestorHeight > height || ancestorHeight < m_prunedHeight)
+    return -1;
+
+  while (height > ancestorHeight && index >= 0)
+  {
+    const BlockIndexEntry &entry = GetIndexRow(height)[index];
+    int skipHeight = GetSkipHeight(height);
+    int skipHeightPrev = GetSkipHeight(height - 1);
+
+    /**
+     * Take the skip pointer unless the parent's skip pointer gets closer to the ancestor
+     */
+    if (entry.skip >= 0 && (skipHeight == ancestorHeight ||
+        (skipHeight > ancestorHeight && !(skipHeightPrev < skipHeight - 2 && skipHeightPrev >= ancestorHeight))))
+    {
+      index = entry.skip;
+      height = skipHeight;
+    }
+    else
+    {
+      index = entry.parent;
+      height--;
+    }
+  }
+  return index;
+}
+
+
+void 
+Blockchain::UpdateSkipIndex (int height, int index)
+{
+  BlockIndexEntry &entry = GetIndexRow(height)[index];
+
+  entry.skip = GetAncestorIndex(height - 1, entry.parent, GetSkipHeight(height));
+
+  if (height + 1 <= GetBlockchainHeight())
+  {
+    for (int i = 0; i < GetRow(height + 1).size(); i++)
+    {
+      if (GetIndexRow(height + 1)[i].parent == index)
+        UpdateSkipIndex(height + 1, i);
+    }
+  }
+}
+
+
+void 
+Blockchain::UpdateForkLength (int height, int index)
+{
+  BlockIndexEntry &entry = GetIndexRow(height)[index];
+  int              length = 0;
+
+  /**
+   * A block with siblings extends the fork of its parent by one
+   */
+  if (GetRow(height).size() > 1)
+  {
+    length = 1;
+    if (entry.parent >= 0 && height - 1 >= m_prunedHeight)
+      length += GetIndexRow(height - 1)[entry.parent].forkLength;
+  }
+
+  if (length == entry.forkLength)
+    return;
+
+  entry.forkLength = length;
+  if (length > m_longestForkSize)
+    m_longestForkSize = length;
+
+  if (height + 1 <= GetBlockchainHeight())
+  {
+    for (int i = 0; i < GetRow(height + 1).size(); i++)
+    {
+      if (GetIndexRow(height + 1)[i].parent == index)
+        UpdateForkLength(height + 1, i);
+    }
+  }
+}
+
+
+/**
+ *
+ * Class AliasSampler functions
+ *
+ */
+
+AliasSampler::AliasSampler (void)
+{
+  std::vector<double> weights;
+
+  m_intervals.push_back(0);
+  m_intervals.push_back(1);
+  Build (weights);
+}
+
+
+AliasSampler::~AliasSampler (void)
+{
+}
+
+
+size_t
+AliasSampler::GetNoIntervals (void) const
+{
+  return m_aliases.size();
+}
+
+
+void
+AliasSampler::Build (const std::vector<double> &weights)
+{
+  std::vector<double>     scaled (weights);
+  std::vector<uint32_t>   small;
+  std::vector<uint32_t>   large;
+  double                  sum = 0;
+
+  /**
+   * Like std::piecewise_constant_distribution, fall back to a single interval [0, 1)
+   * with weight 1 if no weights are given
+   */
+  if (scaled.empty() || m_intervals.size() < 2)
+  {
+    m_intervals.assign(1, 0);
+    m_intervals.push_back(1);
+    scaled.assign(1, 1);
+  }
+
+  for (auto &weight : scaled)
+    sum += weight;
+
+  if (sum <= 0)
+    NS_FATAL_ERROR ("AliasSampler: the sum of the weights must be positive");
+
+  m_probabilities.assign(scaled.size(), 1);
+  m_aliases.resize(scaled.size());
+
+  for (uint32_t i = 0; i < scaled.size(); i++)
+  {
+    m_aliases[i] = i;
+    scaled[i] *= scaled.size() / sum;
+
+    if (scaled[i] < 1)
+      small.push_back(i);
+    else
+      large.push_back(i);
+  }
+
+  while (!small.empty() && !large.empty())
+  {
+    uint32_t less = small.back();
+    uint32_t more = large.back();
+    small.pop_back();
+
+    m_probabilities[less] = scaled[less];
+    m_aliases[less] = more;
+    scaled[more] -= 1 - scaled[less];
+
+    if (scaled[more] < 1)
+    {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+
+  /**
+   * The remaining columns are full, up to rounding errors
+   */
+  for (auto &i : small)
+    m_probabilities[i] = 1;
+  for (auto &i : large)
+    m_probabilities[i] = 1;
+}
+
+
+/**
+ *
+ * Protocol profiles
+ *
+ */
+
+constexpr int ProtocolProfile::bitcoinPort;
+constexpr int ProtocolProfile::secondsPerMin;
+constexpr int ProtocolProfile::countBytes;
+constexpr int ProtocolProfile::bitcoinMessageHeader;
+constexpr int ProtocolProfile::inventorySizeBytes;
+constexpr int ProtocolProfile::getHeadersSizeBytes;
+constexpr int ProtocolProfile::headersSizeBytes;
+constexpr int ProtocolProfile::blockHeadersSizeBytes;
+constexpr double ProtocolProfile::averageTransactionSize;
+constexpr int ProtocolProfile::transactionIndexSize;
+
+constexpr double CryptocurrencyProfile<BITCOIN>::blockSizeIntervals[];
+constexpr double CryptocurrencyProfile<BITCOIN>::blockSizeWeights[];
+constexpr double CryptocurrencyProfile<LITECOIN>::blockSizeIntervals[];
+constexpr double CryptocurrencyProfile<LITECOIN>::blockSizeWeights[];
+constexpr double CryptocurrencyProfile<DOGECOIN>::blockSizeIntervals[];
+constexpr double CryptocurrencyProfile<DOGECOIN>::blockSizeWeights[];
+
+
+const AliasSampler &
+GetBlockSizeSampler (enum Cryptocurrency cryptocurrency)
+{
+  switch (cryptocurrency)
+  {
+    case LITECOIN: return GetBlockSizeSampler<LITECOIN> ();
+    case DOGECOIN: return GetBlockSizeSampler<DOGECOIN> ();
+    default: return GetBlockSizeSampler<BITCOIN> ();
+  }
+}
+
+
+/**
+ *
+ * Class TimerWheel functions
+ *
+ */
+
+TimerWheel::TimerWheel (void) : m_currentTick (0)
+{
+}
+
+
+TimerWheel::~TimerWheel (void)
+{
+}
+
+
+void
+TimerWheel::Arm (const std::string &key, uint64_t ticks)
+{
+  std::list<std::string> fresh (1, key);
+
+  Cancel (key);
+  Place (fresh, fresh.begin(), m_currentTick + std::max<uint64_t> (ticks, 1));
+}
+
+
+bool
+TimerWheel::Cancel (const std::string &key)
+{
+  std::unordered_map<std::string, Timer>::iterator it = m_timers.find(key);
+
+  if (it == m_timers.end())
+    return false;
+
+  m_slots[it->second.level][it->second.slot].erase(it->second.position);
+  m_timers.erase(it);
+  return true;
+}
+
+
+bool
+TimerWheel::IsArmed (const std::string &key) const
+{
+  return m_timers.find(key) != m_timers.end();
+}
+
+
+bool
+TimerWheel::IsEmpty (void) const
+{
+  return m_timers.empty();
+}
+
+
+size_t
+TimerWheel::GetSize (void) const
+{
+  return m_timers.size();
+}
+
+
+uint64_t
+TimerWheel::GetCurrentTick (void) const
+{
+  return m_currentTick;
+}
+
+
+std::vector<std::string>
+TimerWheel::GetArmedKeys (void) const
+{
+  std::vector<std::string> keys;
+
+  keys.reserve(m_timers.size());
+  for (auto &timer : m_timers)
+    keys.push_back(timer.first);
+
+  return keys;
+}
+
+
+std::vector<std::string>
+TimerWheel::Advance (void)
+{
+  std::vector<std::string> expired;
+
+  m_currentTick++;
+
+  /**
+   * Bring down the timeouts of the higher levels whose range starts now.
+   * Start from the highest level, so that they can cascade all the way down in a single tick.
+   */
+  for (int level = m_noLevels - 1; level > 0; level--)
+  {
+    if ((m_currentTick & ((static_cast<uint64_t>(1) << (m_slotBits * level)) - 1)) == 0)
+      Cascade (level);
+  }
+
+  std::list<std::string> &slot = m_slots[0][m_currentTick & (m_noSlots - 1)];
+
+  expired.reserve(slot.size());
+  for (auto &key : slot)
+  {
+    expired.push_back(key);
+    m_timers.erase(key);
+  }
+  slot.clear();
+
+  return expired;
+}
+
+
+void
+TimerWheel::Place (std::list<std::string> &from, std::list<std::string>::iterator it, uint64_t expiry)
+{
+  const uint64_t maxDelta = (static_cast<uint64_t>(1) << (m_slotBits * m_noLevels)) - 1;
+  uint64_t       delta;
+  int            level = 0;
+  int            slot;
+
+  if (expiry < m_currentTick)
+    expiry = m_currentTick;
+  else if (expiry - m_currentTick > maxDelta)
+    expiry = m_currentTick + maxDelta;
+
+  delta = expiry - m_currentTick;
+  while (level < m_noLevels - 1 && delta >= (static_cast<uint64_t>(1) << (m_slotBits * (level + 1))))
+    level++;
+
+  slot = (expiry >> (m_slotBits * level)) & (m_noSlots - 1);
+  m_slots[level][slot].splice(m_slots[level][slot].end(), from, it);
+
+  Timer &timer = m_timers[*it];
+  timer.expiry = expiry;
+  timer.level = level;
+  timer.slot = slot;
+  timer.position = it;
+}
+
+
+void
+TimerWheel::Cascade (int level)
+{
+  std::list<std::string> pending;
+
+  pending.swap(m_slots[level][(m_currentTick >> (m_slotBits * level)) & (m_noSlots - 1)]);
+
+  while (!pending.empty())
+    Place (pending, pending.begin(), m_timers[pending.front()].expiry);
+}
+
+
+#ifdef BITCOIN_HANDLER_PROFILING
+/**
+ *
+ * Class HandlerProfile functions
+ *
+ */
+
+long HandlerProfile::m_invocations[NO_HANDLERS] = {};
+double HandlerProfile::m_time[NO_HANDLERS] = {};
+
+HandlerProfile::HandlerProfile (int handler)
+  : m_handler (handler), m_start (std::chrono::steady_clock::now ())
+{
+}
+
+HandlerProfile::~HandlerProfile ()
+{
+  if (m_handler < 0 || m_handler >= NO_HANDLERS)
+    return;
+
+  m_invocations[m_handler]++;
+  m_time[m_handler] += std::chrono::duration<double> (std::chrono::steady_clock::now () - m_start).count ();
+}
+
+
+void
+HandlerProfile::Print (std::ostream &out, uint32_t systemId)
+{
+  out << "SystemId " << systemId << " handler profile (handler, invocations, total time (s), mean time (us)):\n";
+  for (int i = 0; i < NO_HANDLERS; i++)
+  {
+    if (m_invocations[i] == 0)
+      continue;
+
+    out << "SystemId " << systemId << ": " << getHandlerName(i) << ", " << m_invocations[i] << ", "
+        << m_time[i] << ", " << m_time[i] / m_invocations[i] * 1e6 << "\n";
+  }
+}
+#endif
+
+
+/**
+ *
+ * Class EventCensus functions
+ *
+ */
+
+bool EventCensus::m_enabled = false;
+bool EventCensus::m_loadProfile = false;
+long EventCensus::m_scheduled[NO_EVENTS] = {};
+long EventCensus::m_executed[NO_EVENTS] = {};
+long EventCensus::m_cancelled[NO_EVENTS] = {};
+long EventCensus::m_residency[NO_EVENTS][EventCensus::m_noResidencyBuckets] = {};
+
+void
+EventCensus::Enable (void)
+{
+  m_enabled = true;
+}
+
+
+bool
+EventCensus::IsEnabled (void)
+{
+  return m_enabled;
+}
+
+
+void
+EventCensus::EnableLoadProfile (void)
+{
+  m_loadProfile = true;
+}
+
+
+bool
+EventCensus::IsLoadProfileEnabled (void)
+{
+  return m_loadProfile;
+}
+
+
+void
+EventCensus::RecordLoad (nodeStatistics *stats, std::chrono::steady_clock::time_point start)
+{
+  stats->processedEvents++;
+  stats->processingTime += std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+
+EventId
+EventCensus::DoSchedule (enum BitcoinEvent kind, const Time &delay, EventImpl *event, nodeStatistics *stats)
+{
+  if (!m_enabled && !m_loadProfile)
+    return Simulator::Schedule (delay, Ptr<EventImpl> (event, false));
+
+  if (m_enabled)
+    m_scheduled[kind]++;
+  return Simulator::Schedule (delay, Ptr<EventImpl> (new CensusEvent (kind, event, m_loadProfile ? stats : nullptr), false));
+}
+
+
+void
+EventCensus::Cancel (enum BitcoinEvent kind, const EventId &event)
+{
+  if (m_enabled && !Simulator::IsExpired (event))
+    m_cancelled[kind]++;
+
+  Simulator::Cancel (event);
+}
+
+
+long
+EventCensus::GetTotalExecuted (void)
+{
+  long total = 0;
+
+  for (int i = 0; i < NO_EVENTS; i++)
+    total += m_executed[i];
+  return total;
+}
+
+
+long
+EventCensus::GetTotalPending (void)
+{
+  long total = 0;
+
+  for (int i = 0; i < NO_EVENTS; i++)
+    total += m_scheduled[i] - m_executed[i] - m_cancelled[i];
+  return total;
+}
+
+
+void
+EventCensus::Print (std::ostream &out, uint32_t systemId)
+{
+  out << "SystemId " << systemId << " event census (event, scheduled, executed, cancelled, pending, "
+      << "queue residency <1ms/<10ms/<100ms/<1s/<10s/<100s/>=100s):\n";
+  for (int i = 0; i < NO_EVENTS; i++)
+  {
+    if (m_scheduled[i] == 0)
+      continue;
+
+    out << "SystemId " << systemId << ": " << getEventName(static_cast<enum BitcoinEvent>(i)) << ", " << m_scheduled[i]
+        << ", " << m_executed[i] << ", " << m_cancelled[i] << ", " << m_scheduled[i] - m_executed[i] - m_cancelled[i] << ",";
+    for (int j = 0; j < m_noResidencyBuckets; j++)
+      out << " " << m_residency[i][j];
+    out << "\n";
+  }
+}
+
+
+EventCensus::CensusEvent::CensusEvent (enum BitcoinEvent kind, EventImpl *event, nodeStatistics *stats)
+  : m_kind (kind), m_scheduledAt (Simulator::Now ()), m_event (event, false), m_stats (stats)
+{
+}
+
+
+void
+EventCensus::CensusEvent::Notify (void)
+{
+  if (m_enabled)
+  {
+    double residency = (Simulator::Now () - m_scheduledAt).GetSeconds ();
+    int bucket = 0;
+
+    for (double limit = 0.001; bucket < m_noResidencyBuckets - 1 && residency >= limit; limit *= 10)
+      bucket++;
+
+    m_executed[m_kind]++;
+    m_residency[m_kind][bucket]++;
+  }
+
+  if (m_stats == nullptr)
+  {
+    m_event->Invoke ();
+    return;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+
+  m_event->Invoke ();
+  RecordLoad (m_stats, start);
+}
+
+
+/**
+ *
+ * Class BinaryTracer functions
+ *
+ */
+
+const uint32_t BinaryTracer::m_capacity;
+
+BinaryTracer::BinaryTracer (void) : m_head (0), m_tail (0), m_running (false), m_file (nullptr), m_stalls (0)
+{
+}
+
+
+BinaryTracer::~BinaryTracer (void)
+{
+  Close ();
+}
+
+
+void
+BinaryTracer::Open (const std::string &fileName, uint32_t systemId, const uint32_t *nodesRegions, uint32_t noNodes)
+{
+  traceFileHeader header = {{'B', 'T', 'C', 'T', 'R', 'A', 'C', 'E'}, 5, sizeof (traceRecord), systemId, noNodes};
+  const uint64_t  padding = 0;
+
+  Close ();
+  m_file = std::fopen (fileName.c_str (), "wb");
+  if (m_file == nullptr)
+  {
+    NS_FATAL_ERROR ("Cannot open the binary trace " << fileName);
+  }
+  std::fwrite (&header, sizeof (header), 1, m_file);
+  std::fwrite (nodesRegions, sizeof (uint32_t), noNodes, m_file);
+  std::fwrite (&padding, 1, getTraceRecordsOffset (noNodes) - sizeof (header) - noNodes * sizeof (uint32_t), m_file);
+
+  m_ring.resize (m_capacity);
+  m_head.store (0);
+  m_tail.store (0);
+  m_running.store (true);
+  m_writer = std::thread (&BinaryTracer::Drain, this);
+}
+
+
+void
+BinaryTracer::Close (void)
+{
+  if (m_file == nullptr)
+    return;
+
+  m_running.store (false, std::memory_order_release);
+  m_writer.join ();
+  std::fclose (m_file);
+  m_file = nullptr;
+}
+
+
+void
+BinaryTracer::Connect (Ptr<Application> node)
+{
+  node->TraceConnectWithoutContext ("BlockMined", MakeCallback (&BinaryTracer::BlockMined, this));
+  node->TraceConnectWithoutContext ("BlockReceived", MakeCallback (&BinaryTracer::BlockReceived, this));
+  node->TraceConnectWithoutContext ("BlockValidated", MakeCallback (&BinaryTracer::BlockValidated, this));
+  node->TraceConnectWithoutContext ("OrphanAdded", MakeCallback (&BinaryTracer::OrphanAdded, this));
+  node->TraceConnectWithoutContext ("TimeoutFired", MakeCallback (&BinaryTracer::TimeoutFired, this));
+  node->TraceConnectWithoutContext ("ChunkReceived", MakeCallback (&BinaryTracer::ChunkReceived, this));
+  node->TraceConnectWithoutContext ("MessageSent", MakeCallback (&BinaryTracer::MessageSent, this));
+  node->TraceConnectWithoutContext ("ChainReorg", MakeCallback (&BinaryTracer::ChainReorg, this));
+}
+
+
+void
+BinaryTracer::BlockMined (const blockTrace &block)
+{
+  RecordBlock (BLOCK_MINED_TRACE, block);
+}
+
+
+void
+BinaryTracer::BlockReceived (const blockTrace &block)
+{
+  RecordBlock (BLOCK_RECEIVED_TRACE, block);
+}
+
+
+void
+BinaryTracer::BlockValidated (const blockTrace &block)
+{
+  RecordBlock (BLOCK_VALIDATED_TRACE, block);
+}
+
+
+void
+BinaryTracer::OrphanAdded (const blockTrace &block)
+{
+  RecordBlock (ORPHAN_ADDED_TRACE, block);
+}
+
+
+void
+BinaryTracer::TimeoutFired (const timeoutTrace &timeout)
+{
+  traceRecord record = {Simulator::Now ().GetNanoSeconds (), static_cast<uint32_t> (timeout.nodeId), 0,
+                        timeout.blockHeight, timeout.minerId, timeout.chunkId, 0, TIMEOUT_FIRED_TRACE, NO_MESSAGE, -1};
+  Append (record);
+}
+
+
+void
+BinaryTracer::ChunkReceived (const chunkTrace &chunk)
+{
+  traceRecord record = {Simulator::Now ().GetNanoSeconds (), static_cast<uint32_t> (chunk.nodeId), chunk.peer,
+                        chunk.blockHeight, chunk.minerId, chunk.chunkId, 0, CHUNK_RECEIVED_TRACE, NO_MESSAGE, -1};
+  Append (record);
+}
+
+
+void
+BinaryTracer::MessageSent (const messageTrace &message)
+{
+  traceRecord record = {Simulator::Now ().GetNanoSeconds (), static_cast<uint32_t> (message.nodeId), message.peer,
+                        -1, -1, -1, message.bytes, MESSAGE_SENT_TRACE, static_cast<uint16_t> (message.message), -1};
+  Append (record);
+}
+
+
+void
+BinaryTracer::ChainReorg (const reorgTrace &reorg)
+{
+  traceRecord record = {Simulator::Now ().GetNanoSeconds (), static_cast<uint32_t> (reorg.nodeId), 0,
+                        reorg.newTopHeight, reorg.newTopMinerId, -1, static_cast<uint32_t> (reorg.depth),
+                        CHAIN_REORG_TRACE, NO_MESSAGE, reorg.oldTopHeight};
+  Append (record);
+}
+
+
+uint64_t
+BinaryTracer::GetNoRecords (void) const
+{
+  return m_tail.load ();
+}
+
+
+uint64_t
+BinaryTracer::GetNoStalls (void) const
+{
+  return m_stalls;
+}
+
+
+void
+BinaryTracer::RecordBlock (enum TraceEventType type, const blockTrace &block)
+{
+  traceRecord record = {Simulator::Now ().GetNanoSeconds (), static_cast<uint32_t> (block.nodeId), block.peer,
+                        block.blockHeight, block.minerId, -1, static_cast<uint32_t> (block.blockSizeBytes),
+                        static_cast<uint16_t> (type), NO_MESSAGE, -1};
+  Append (record);
+}
+
+
+void
+BinaryTracer::Append (const traceRecord &record)
+{
+  uint64_t tail = m_tail.load (std::memory_order_relaxed);
+
+  if (tail - m_head.load (std::memory_order_acquire) == m_capacity)
+  {
+    m_stalls++;
+    while (tail - m_head.load (std::memory_order_acquire) == m_capacity)
+      std::this_thread::yield ();
+  }
+
+  m_ring[tail & (m_capacity - 1)] = record;
+  m_tail.store (tail + 1, std::memory_order_release);
+}
+
+
+void
+BinaryTracer::Drain (void)
+{
+  for (;;)
+  {
+    bool     running = m_running.load (std::memory_order_acquire);
+    uint64_t head = m_head.load (std::memory_order_relaxed);
+    uint64_t tail = m_tail.load (std::memory_order_acquire);
+
+    if (head == tail)
+    {
+      if (!running)
+        return;
+      std::this_thread::sleep_for (std::chrono::milliseconds (1));
+      continue;
+    }
+
+    /**
+     * Encode the records up to the tail, or up to the end of the ring buffer if they wrap around, as one batch
+     */
+    uint64_t         first = head & (m_capacity - 1);
+    uint64_t         count = std::min (tail - head, m_capacity - first);
+    traceBatchHeader batchHeader;
+
+    m_batch.clear ();
+    encodeTraceRecords (&m_ring[first], count, m_batch);
+    m_head.store (head + count, std::memory_order_release);
+
+    batchHeader.noRecords = count;
+    batchHeader.encodedBytes = m_batch.size ();
+    std::fwrite (&batchHeader, sizeof (batchHeader), 1, m_file);
+    std::fwrite (&m_batch[0], 1, m_batch.size (), m_file);
+  }
+}
+
+
+/**
+ *
+ * Class RunTelemetry functions
+ *
+ */
+
+RunTelemetry::RunTelemetry (void) : m_format (JSON_LINES_TELEMETRY), m_systemId (0), m_minWallInterval (0), m_startWallTime (0),
+                                    m_lastWallTime (0), m_lastExecuted (0), m_chainHeight (0)
+{
+}
+
+
+void
+RunTelemetry::Start (const std::string &fileName, enum TelemetryFormat format, uint32_t systemId, Time interval, double minWallInterval)
+{
+  m_fileName = fileName;
+  m_format = format;
+  m_systemId = systemId;
+  m_interval = interval;
+  m_minWallInterval = minWallInterval;
+  m_startWallTime = m_lastWallTime = GetWallTime ();
+  m_lastExecuted = 0;
+
+  if (m_format == JSON_LINES_TELEMETRY)
+  {
+    std::ofstream file (m_fileName.c_str (), std::ios::trunc);
+    if (!file.is_open ())
+    {
+      NS_FATAL_ERROR ("Cannot open the telemetry file " << m_fileName);
+    }
+  }
+
+  EventCensus::Enable ();
+  m_nextReport = Simulator::Schedule (m_interval, &RunTelemetry::Report, this);
+}
+
+
+void
+RunTelemetry::Stop (void)
+{
+  if (m_fileName.empty ())
+    return;
+
+  Simulator::Cancel (m_nextReport);
+  Write (GetWallTime ());
+  m_fileName.clear ();
+}
+
+
+void
+RunTelemetry::Connect (Ptr<Application> node)
+{
+  node->TraceConnectWithoutContext ("BlockMined", MakeCallback (&RunTelemetry::BlockTraced, this));
+  node->TraceConnectWithoutContext ("BlockValidated", MakeCallback (&RunTelemetry::BlockTraced, this));
+}
+
+
+void
+RunTelemetry::Report (void)
+{
+  double wallTime = GetWallTime ();
+
+  if (wallTime - m_lastWallTime >= m_minWallInterval)
+    Write (wallTime);
+
+  m_nextReport = Simulator::Schedule (m_interval, &RunTelemetry::Report, this);
+}
+
+
+void
+RunTelemetry::Write (double wallTime)
+{
+  struct rusage usage;
+  long   executed = EventCensus::GetTotalExecuted ();
+  double eventsPerSecond = wallTime > m_lastWallTime ? (executed - m_lastExecuted) / (wallTime - m_lastWallTime) : 0;
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  if (m_format == JSON_LINES_TELEMETRY)
+  {
+    std::ofstream file (m_fileName.c_str (), std::ios::app);
+
+    file << "{\"systemId\": " << m_systemId << ", \"wallTime\": " << wallTime - m_startWallTime
+         << ", \"simulatedTime\": " << Simulator::Now ().GetSeconds () << ", \"chainHeight\": " << m_chainHeight
+         << ", \"eventsPerSecond\": " << eventsPerSecond << ", \"pendingEvents\": " << EventCensus::GetTotalPending ()
+         << ", \"peakRssKB\": " << usage.ru_maxrss << "}\n";
+  }
+  else
+  {
+    /**
+     * Write a new file and rename it, so that the scraper never reads a partial report
+     */
+    std::string temporaryName = m_fileName + ".tmp";
+    std::ofstream file (temporaryName.c_str (), std::ios::trunc);
+    std::ostringstream labels;
+
+    labels << "{system_id=\"" << m_systemId << "\"}";
+    file << "# TYPE bitcoin_wall_time_seconds gauge\nbitcoin_wall_time_seconds" << labels.str () << " " << wallTime - m_startWallTime << "\n"
+         << "# TYPE bitcoin_simulated_time_seconds gauge\nbitcoin_simulated_time_seconds" << labels.str () << " " << Simulator::Now ().GetSeconds () << "\n"
+         << "# TYPE bitcoin_chain_height gauge\nbitcoin_chain_height" << labels.str () << " " << m_chainHeight << "\n"
+         << "# TYPE bitcoin_events_per_second gauge\nbitcoin_events_per_second" << labels.str () << " " << eventsPerSecond << "\n"
+         << "# TYPE bitcoin_pending_events gauge\nbitcoin_pending_events" << labels.str () << " " << EventCensus::GetTotalPending () << "\n"
+         << "# TYPE bitcoin_peak_rss_bytes gauge\nbitcoin_peak_rss_bytes" << labels.str () << " " << static_cast<long> (usage.ru_maxrss) * 1024 << "\n";
+    file.close ();
+    std::rename (temporaryName.c_str (), m_fileName.c_str ());
+  }
+
+  m_lastWallTime = wallTime;
+  m_lastExecuted = executed;
+}
+
+
+void
+RunTelemetry::BlockTraced (const blockTrace &block)
+{
+  m_chainHeight = std::max (m_chainHeight, block.blockHeight);
+}
+
+
+/**
+ *
+ * Class BitcoinTopology functions
+ *
+ */
+
+BitcoinTopology::BitcoinTopology (std::vector<uint32_t> offsets, std::vector<Ipv4Address> peersAddresses, std::vector<uint32_t> peersNodeIds,
+                                  std::vector<double> peersDownloadSpeeds, std::vector<double> peersUploadSpeeds,
+                                  std::vector<nodeInternetSpeeds> nodesInternetSpeeds)
+  : m_offsets (std::move (offsets)), m_peersAddresses (std::move (peersAddresses)), m_peersNodeIds (std::move (peersNodeIds)),
+    m_peersDownloadSpeeds (std::move (peersDownloadSpeeds)), m_peersUploadSpeeds (std::move (peersUploadSpeeds)),
+    m_nodesInternetSpeeds (std::move (nodesInternetSpeeds))
+{
+  if (m_offsets.empty () || m_offsets.back () != m_peersAddresses.size ()
+      || m_peersNodeIds.size () != m_peersAddresses.size ()
+      || m_peersDownloadSpeeds.size () != m_peersAddresses.size () || m_peersUploadSpeeds.size () != m_peersAddresses.size ()
+      || m_nodesInternetSpeeds.size () != m_offsets.size () - 1)
+    NS_FATAL_ERROR ("BitcoinTopology: the connection arrays do not match the offsets");
+
+  /**
+   * Build the reverse address index
+   */
+  m_connectionsNodeIds.resize (m_peersAddresses.size ());
+  m_addressIndex.reserve (m_peersAddresses.size ());
+
+  for (uint32_t node = 0; node < GetNoNodes (); node++)
+  {
+    for (uint32_t connection = m_offsets[node]; connection < m_offsets[node + 1]; connection++)
+    {
+      m_connectionsNodeIds[connection] = node;
+      m_addressIndex.push_back (std::make_pair (m_peersAddresses[connection].Get (), connection));
+    }
+  }
+  std::sort (m_addressIndex.begin (), m_addressIndex.end ());
+}
+
+
+uint32_t
+BitcoinTopology::GetNoNodes (void) const
+{
+  return m_offsets.size () - 1;
+}
+
+
+uint32_t
+BitcoinTopology::GetNoConnections (void) const
+{
+  return m_peersAddresses.size ();
+}
+
+
+Span<Ipv4Address>
+BitcoinTopology::GetPeersAddresses (uint32_t nodeId) const
+{
+  return Span<Ipv4Address> (m_peersAddresses.data () + m_offsets.at (nodeId), m_offsets.at (nodeId + 1) - m_offsets[nodeId]);
+}
+
+
+Span<uint32_t>
+BitcoinTopology::GetPeersNodeIds (uint32_t nodeId) const
+{
+  return Span<uint32_t> (m_peersNodeIds.data () + m_offsets.at (nodeId), m_offsets.at (nodeId + 1) - m_offsets[nodeId]);
+}
+
+
+Span<double>
+BitcoinTopology::GetPeersDownloadSpeeds (uint32_t nodeId) const
+{
+  return Span<double> (m_peersDownloadSpeeds.data () + m_offsets.at (nodeId), m_offsets.at (nodeId + 1) - m_offsets[nodeId]);
+}
+
+
+Span<double>
+BitcoinTopology::GetPeersUploadSpeeds (uint32_t nodeId) const
+{
+  return Span<double> (m_peersUploadSpeeds.data () + m_offsets.at (nodeId), m_offsets.at (nodeId + 1) - m_offsets[nodeId]);
+}
+
+
+const nodeInternetSpeeds &
+BitcoinTopology::GetNodeInternetSpeeds (uint32_t nodeId) const
+{
+  return m_nodesInternetSpeeds.at (nodeId);
+}
+
+
+ipv4AddressOwner
+BitcoinTopology::GetAddressOwner (Ipv4Address address) const
+{
+  ipv4AddressOwner owner;
+  auto it = std::lower_bound (m_addressIndex.begin (), m_addressIndex.end (), std::make_pair (address.Get (), static_cast<uint32_t> (0)));
+
+  if (it == m_addressIndex.end () || it->first != address.Get ())
+  {
+    owner.nodeId = -1;
+    owner.peerIndex = -1;
+  }
+  else
+  {
+    owner.nodeId = m_peersNodeIds[it->second];
+    owner.peerIndex = it->second - m_offsets[m_connectionsNodeIds[it->second]];
+  }
+  return owner;
+}
+
+
+bool operator== (const Block &block1, const Block &block2)
+{
+  if (block1.GetBlockHeight() == block2.GetBlockHeight() && block1.GetMinerId() == block2.GetMinerId())
+    return true;
+  else
+    return false;
+}
+
+bool operator== (const BitcoinChunk &chunk1, const BitcoinChunk &chunk2)
+{
+  if (chunk1.GetBlockHeight() == chunk2.GetBlockHeight() && chunk1.GetMinerId() == chunk2.GetMinerId() && chunk1.GetChunkId() == chunk2.GetChunkId())
+    return true;
+  else
+    return false;
+}
+
+bool operator< (const BitcoinChunk &chunk1, const BitcoinChunk &chunk2)
+{
+  if (chunk1.GetBlockHeight() < chunk2.GetBlockHeight())
+    return true;
+  else if (chunk1.GetBlockHeight() == chunk2.GetBlockHeight() && chunk1.GetMinerId() < chunk2.GetMinerId())
+    return true;
+  else if (chunk1.GetBlockHeight() == chunk2.GetBlockHeight() && chunk1.GetMinerId() == chunk2.GetMinerId() && chunk1.GetChunkId() < chunk2.GetChunkId())
+    return true;
+  else
+    return false;
+}
+
+std::ostream& operator<< (std::ostream &out, const Block &block)
+{
+
+    out << "(m_blockHeight: " << block.GetBlockHeight() << ", " <<
+        "m_minerId: " << block.GetMinerId() << ", " <<
+        "m_parentBlockMinerId: " << block.GetParentBlockMinerId() << ", " <<
+        "m_blockSizeBytes: " << block.GetBlockSizeBytes() << ", " <<
+        "m_timeCreated: " << block.GetTimeCreated() << ", " <<
+        "m_timeReceived: " << block.GetTimeReceived() << ", " <<
+        "m_receivedFromIpv4: " << block.GetReceivedFromIpv4() <<
+        ")";
+    return out;
+}
+
+std::ostream& operator<< (std::ostream &out, const BitcoinChunk &chunk)
+{
+
+    out << "(m_blockHeight: " << chunk.GetBlockHeight() << ", " <<
+        "m_minerId: " << chunk.GetMinerId() << ", " <<
+        "chunkId: " << chunk.GetChunkId() << ", " <<
+        "m_parentBlockMinerId: " << chunk.GetParentBlockMinerId() << ", " <<
+        "m_blockSizeBytes: " << chunk.GetBlockSizeBytes() << ", " <<
+        "m_timeCreated: " << chunk.GetTimeCreated() << ", " <<
+        "m_timeReceived: " << chunk.GetTimeReceived() << ", " <<
+        "m_receivedFromIpv4: " << chunk.GetReceivedFromIpv4() <<
+        ")";
+    return out;
+}
+
+std::ostream& operator<< (std::ostream &out, Blockchain &blockchain)
+{
+  
+  std::deque< std::vector<Block>>::iterator blockHeight_it;
+  std::vector<Block>::iterator  block_it;
   int i;
   
-  for (blockHeight_it = blockchain.m_blocks.begin(), i = 0; blockHeight_it < blockchain.m_blocks.end(); blockHeight_it++, i++) 
+  if (blockchain.m_prunedHeight > 0)
+    out << "  PRUNED " << blockchain.m_prunedBlocks << " BLOCKS BELOW HEIGHT " << blockchain.m_prunedHeight << "\n";
+
+  for (blockHeight_it = blockchain.m_blocks.begin(), i = blockchain.m_prunedHeight; blockHeight_it < blockchain.m_blocks.end(); blockHeight_it++, i++) 
   {
     out << "  BLOCK HEIGHT " << i << ":\n";
     for (block_it = blockHeight_it->begin();  block_it < blockHeight_it->end(); block_it++)
@@ -776,6 +2027,219 @@ const char* getBitcoinRegion(enum BitcoinRegion m)
 }
 
 
+const char* getHandlerName(int handler)
+{
+  if (handler >= 0 && handler <= EXT_GET_DATA)
+    return getMessageName(static_cast<enum Messages>(handler));
+
+  switch (handler) 
+  {
+    case SEND_BLOCK_HANDLER: return "SendBlock";
+    case SEND_CHUNK_HANDLER: return "SendChunk";
+    case RECEIVED_BLOCK_MESSAGE_HANDLER: return "ReceivedBlockMessage";
+    case RECEIVED_CHUNK_MESSAGE_HANDLER: return "ReceivedChunkMessage";
+    case AFTER_BLOCK_VALIDATION_HANDLER: return "AfterBlockValidation";
+    case INV_TIMEOUT_EXPIRED_HANDLER: return "InvTimeoutExpired";
+    case CHUNK_TIMEOUT_EXPIRED_HANDLER: return "ChunkTimeoutExpired";
+    case MINE_BLOCK_HANDLER: return "MineBlock";
+    default: return "UNKNOWN";
+  }
+}
+
+
+const char* getEventName(enum BitcoinEvent e)
+{
+  switch (e) 
+  {
+    case SEND_BLOCK_EVENT: return "SendBlock";
+    case SEND_CHUNK_EVENT: return "SendChunk";
+    case REMOVE_SEND_TIME_EVENT: return "RemoveSendTime";
+    case REMOVE_COMPRESSED_BLOCK_SEND_TIME_EVENT: return "RemoveCompressedBlockSendTime";
+    case RECEIVED_BLOCK_MESSAGE_EVENT: return "ReceivedBlockMessage";
+    case RECEIVED_CHUNK_MESSAGE_EVENT: return "ReceivedChunkMessage";
+    case REMOVE_RECEIVE_TIME_EVENT: return "RemoveReceiveTime";
+    case REMOVE_COMPRESSED_BLOCK_RECEIVE_TIME_EVENT: return "RemoveCompressedBlockReceiveTime";
+    case AFTER_BLOCK_VALIDATION_EVENT: return "AfterBlockValidation";
+    case FLUSH_PENDING_INV_EVENT: return "FlushPendingInv";
+    case TIMEOUT_TICK_EVENT: return "TimeoutTick";
+    case MINE_BLOCK_EVENT: return "MineBlock";
+    default: return "UNKNOWN";
+  }
+}
+
+
+const char* getTraceEventName(enum TraceEventType t)
+{
+  switch (t) 
+  {
+    case BLOCK_MINED_TRACE: return "BlockMined";
+    case BLOCK_RECEIVED_TRACE: return "BlockReceived";
+    case BLOCK_VALIDATED_TRACE: return "BlockValidated";
+    case ORPHAN_ADDED_TRACE: return "OrphanAdded";
+    case TIMEOUT_FIRED_TRACE: return "TimeoutFired";
+    case CHUNK_RECEIVED_TRACE: return "ChunkReceived";
+    case MESSAGE_SENT_TRACE: return "MessageSent";
+    case CHAIN_REORG_TRACE: return "ChainReorg";
+    default: return "UNKNOWN";
+  }
+}
+
+
+const char* getHopDelayName(enum HopDelay d)
+{
+  switch (d) 
+  {
+    case ANNOUNCEMENT_HOP_DELAY: return "Announcement";
+    case REQUEST_RTT_HOP_DELAY: return "Request RTT";
+    case UPLOAD_QUEUEING_HOP_DELAY: return "Upload queueing";
+    case TRANSMISSION_HOP_DELAY: return "Transmission";
+    case DOWNLOAD_QUEUEING_HOP_DELAY: return "Download queueing";
+    case VALIDATION_HOP_DELAY: return "Validation";
+    default: return "UNKNOWN";
+  }
+}
+
+
+size_t getTraceRecordsOffset(uint32_t noNodes)
+{
+  size_t offset = sizeof (traceFileHeader) + noNodes * sizeof (uint32_t);
+
+  return (offset + 7) / 8 * 8;
+}
+
+
+static void
+PutVarint (std::vector<uint8_t> &encoded, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    encoded.push_back (static_cast<uint8_t> (value) | 0x80);
+    value >>= 7;
+  }
+  encoded.push_back (static_cast<uint8_t> (value));
+}
+
+
+static bool
+GetVarint (const uint8_t *&encoded, const uint8_t *end, uint64_t &value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64 && encoded < end; shift += 7)
+  {
+    uint8_t byte = *encoded++;
+
+    value |= static_cast<uint64_t> (byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+
+static uint64_t
+ZigZag (int64_t value)
+{
+  return (static_cast<uint64_t> (value) << 1) ^ static_cast<uint64_t> (value >> 63);
+}
+
+
+static int64_t
+UnZigZag (uint64_t value)
+{
+  return static_cast<int64_t> (value >> 1) ^ -static_cast<int64_t> (value & 1);
+}
+
+
+void encodeTraceRecords(const traceRecord *records, size_t count, std::vector<uint8_t> &encoded)
+{
+  int64_t previousTime = 0;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const traceRecord &record = records[i];
+
+    PutVarint (encoded, ZigZag (record.time - previousTime));
+    PutVarint (encoded, record.eventType);
+    PutVarint (encoded, record.nodeId);
+    PutVarint (encoded, record.peer);
+    PutVarint (encoded, ZigZag (record.blockHeight));
+    PutVarint (encoded, ZigZag (record.minerId));
+    PutVarint (encoded, ZigZag (record.chunkId));
+    PutVarint (encoded, record.bytes);
+    PutVarint (encoded, record.message);
+    PutVarint (encoded, ZigZag (record.oldTopHeight));
+    previousTime = record.time;
+  }
+}
+
+
+bool decodeTraceRecords(const uint8_t *encoded, size_t encodedBytes, uint32_t noRecords, std::vector<traceRecord> &records)
+{
+  const uint8_t *end = encoded + encodedBytes;
+  int64_t        previousTime = 0;
+  uint64_t       fields[10];
+
+  records.resize (noRecords);
+  for (uint32_t i = 0; i < noRecords; i++)
+  {
+    traceRecord &record = records[i];
+
+    for (int j = 0; j < 10; j++)
+    {
+      if (!GetVarint (encoded, end, fields[j]))
+        return false;
+    }
+
+    record.time = previousTime + UnZigZag (fields[0]);
+    record.eventType = static_cast<uint16_t> (fields[1]);
+    record.nodeId = static_cast<uint32_t> (fields[2]);
+    record.peer = static_cast<uint32_t> (fields[3]);
+    record.blockHeight = static_cast<int32_t> (UnZigZag (fields[4]));
+    record.minerId = static_cast<int32_t> (UnZigZag (fields[5]));
+    record.chunkId = static_cast<int32_t> (UnZigZag (fields[6]));
+    record.bytes = static_cast<uint32_t> (fields[7]);
+    record.message = static_cast<uint16_t> (fields[8]);
+    record.oldTopHeight = static_cast<int32_t> (UnZigZag (fields[9]));
+    previousTime = record.time;
+  }
+  return encoded == end;
+}
+
+
+void
+ParallelFor (uint32_t n, uint32_t noThreads, const std::function<void (uint32_t)> &task)
+{
+  std::vector<std::thread> workers;
+  uint32_t                 blockSize;
+
+  if (noThreads > n)
+    noThreads = n;
+
+  if (noThreads <= 1)
+  {
+    for (uint32_t i = 0; i < n; i++)
+      task (i);
+    return;
+  }
+
+  /**
+   * Every thread runs the task for a contiguous block of indices
+   */
+  blockSize = (n + noThreads - 1) / noThreads;
+  for (uint32_t t = 0; t < noThreads; t++)
+  {
+    workers.push_back (std::thread ([t, n, blockSize, &task] ()
+    {
+      for (uint32_t i = t * blockSize; i < std::min (n, (t + 1) * blockSize); i++)
+        task (i);
+    }));
+  }
+
+  for (auto &worker : workers)
+    worker.join ();
+}
+
+
 enum BitcoinRegion getBitcoinEnum(uint32_t n)
 {
   switch (n) 
@@ -790,3 +2254,14 @@ enum BitcoinRegion getBitcoinEnum(uint32_t n)
   }
 }
 }// Namespace ns3
+
+
+static double GetWallTime()
+{
+    struct timeval time;
+    if (gettimeofday(&time,NULL)){
+        //  Handle error
+        return 0;
+    }
+    return (double)time.tv_sec + (double)time.tv_usec * .000001;
+}
@@ -9,7 +9,28 @@
 
 #include <vector>
 #include <map>
+#include <iterator>
+#include <list>
+#include <deque>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <ostream>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <stdint.h>
+#include <chrono>
 #include "ns3/address.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/ptr.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/event-impl.h"
+#include "ns3/make-event.h"
+#include "ns3/simulator.h"
+#include "ns3/simple-ref-count.h"
 #include <algorithm>
 
 namespace ns3 {
@@ -35,6 +56,45 @@ enum Messages
 };
 
 
+/**
+ * The handlers timed when BITCOIN_HANDLER_PROFILING is defined. The first ones are the messages
+ * handled in HandleRead, so a message type is also a handler.
+ */
+enum BitcoinHandler
+{
+  SEND_BLOCK_HANDLER = EXT_GET_DATA + 1,
+  SEND_CHUNK_HANDLER,
+  RECEIVED_BLOCK_MESSAGE_HANDLER,
+  RECEIVED_CHUNK_MESSAGE_HANDLER,
+  AFTER_BLOCK_VALIDATION_HANDLER,
+  INV_TIMEOUT_EXPIRED_HANDLER,
+  CHUNK_TIMEOUT_EXPIRED_HANDLER,
+  MINE_BLOCK_HANDLER,
+  NO_HANDLERS
+};
+
+
+/**
+ * The kinds of the events scheduled by the bitcoin nodes and miners, used by the EventCensus.
+ */
+enum BitcoinEvent
+{
+  SEND_BLOCK_EVENT,
+  SEND_CHUNK_EVENT,
+  REMOVE_SEND_TIME_EVENT,
+  REMOVE_COMPRESSED_BLOCK_SEND_TIME_EVENT,
+  RECEIVED_BLOCK_MESSAGE_EVENT,
+  RECEIVED_CHUNK_MESSAGE_EVENT,
+  REMOVE_RECEIVE_TIME_EVENT,
+  REMOVE_COMPRESSED_BLOCK_RECEIVE_TIME_EVENT,
+  AFTER_BLOCK_VALIDATION_EVENT,
+  FLUSH_PENDING_INV_EVENT,
+  TIMEOUT_TICK_EVENT,
+  MINE_BLOCK_EVENT,
+  NO_EVENTS
+};
+
+
 /**
  * The bitcoin miner types that have been implemented. The first one is the normal miner (default), the last 3 are used to simulate different attacks.
  */
@@ -81,6 +141,17 @@ enum Cryptocurrency
 };
 
 
+/** 
+ * The orphan that is evicted from the orphan pool of a blockchain when the pool is full.
+ * EVICT_OLDEST drops the orphan received first, EVICT_NEWEST drops the incoming orphan.
+ */
+enum OrphanEvictionPolicy
+{
+  EVICT_OLDEST,                //DEFAULT
+  EVICT_NEWEST
+};
+
+
 /** 
  * The geographical regions used in the simulation. OTHER was only used for debugging reasons.
  */
@@ -96,6 +167,22 @@ enum BitcoinRegion
 };
 
 
+/**
+ * The components of a propagation hop of a block, i.e. from the sending peer having the block until
+ * the receiving node has validated it. They add up to the duration of the hop.
+ */
+enum HopDelay
+{
+  ANNOUNCEMENT_HOP_DELAY,          //until the block was requested from the sending peer (INV/HEADERS, trickling, timeouts)
+  REQUEST_RTT_HOP_DELAY,           //the round trip of the GET_DATA and the first Byte of the BLOCK
+  UPLOAD_QUEUEING_HOP_DELAY,       //waiting behind the other blocks uploaded by the sending peer
+  TRANSMISSION_HOP_DELAY,          //the block size over the bottleneck of the link
+  DOWNLOAD_QUEUEING_HOP_DELAY,     //waiting behind the other blocks downloaded by the node
+  VALIDATION_HOP_DELAY,
+  NO_HOP_DELAYS
+};
+
+
 /**
  * The struct used for collecting node statistics.
  */
@@ -138,15 +225,159 @@ typedef struct {
   long     blockTimeouts;
   long     chunkTimeouts;
   int      minedBlocksInMainChain;
+  long     orphansResolved;
+  long     orphansEvicted;
+  long     processedEvents;                  //the socket reads and scheduled events handled by the node, 0 without the load profile
+  double   processingTime;                   //the wall clock time spent handling them (s)
+  long     propagationHops;                  //the requested blocks which were received and validated
+  double   meanHopDelays[NO_HOP_DELAYS];     //the mean of each component of these hops (s)
 } nodeStatistics;
 
 
+/**
+ * The compact records passed to the trace sources of the BitcoinNode. Peers are kept as raw 4-Byte Ipv4
+ * addresses, 0 when there is no peer.
+ */
+typedef struct {
+  int      nodeId;                 // The node which fired the trace
+  int      blockHeight;
+  int      minerId;
+  int      blockSizeBytes;
+  double   timeCreated;
+  uint32_t peer;                   // The peer which sent the block
+} blockTrace;
+
+typedef struct {
+  int      nodeId;                 // The node which fired the trace
+  int      blockHeight;
+  int      minerId;
+  int      chunkId;
+  uint32_t peer;                   // The peer which sent the chunk
+} chunkTrace;
+
+typedef struct {
+  int      nodeId;                 // The node which fired the trace
+  int      blockHeight;
+  int      minerId;
+  int      chunkId;                // -1 for block timeouts
+} timeoutTrace;
+
+typedef struct {
+  int            nodeId;           // The node which fired the trace
+  enum Messages  message;
+  uint32_t       peer;             // The peer the message was sent to
+  uint32_t       bytes;            // The Bytes written to the socket, including the delimiter
+} messageTrace;
+
+typedef struct {
+  int      nodeId;                 // The node which fired the trace
+  int      oldTopHeight;           // The replaced top block
+  int      oldTopMinerId;
+  int      newTopHeight;           // The new top block, which is not a descendant of the old one
+  int      newTopMinerId;
+  int      depth;                  // The blocks of the old main chain which left it
+} reorgTrace;
+
+typedef struct {
+  int      nodeId;                 // The node which fired the trace
+  int      blockHeight;
+  int      minerId;
+  uint32_t peer;                   // The peer which sent the block
+  double   delays[NO_HOP_DELAYS];  // The components of the hop (s), indexed by enum HopDelay
+} hopTrace;
+
+/**
+ * The timestamps of a block download, kept until the block is validated and its hop is decomposed.
+ */
+typedef struct {
+  std::map<Ipv4Address, double> timeRequested;     // The last time the block was requested from each peer
+  double                        timeBlockMessage;  // The time the BLOCK message started arriving, -1 before
+  hopTrace                      hop;
+} pendingHop;
+
+
+/**
+ * The output formats of the RunTelemetry.
+ */
+enum TelemetryFormat
+{
+  PROMETHEUS_TELEMETRY,
+  JSON_LINES_TELEMETRY
+};
+
+
+/**
+ * The event types of the binary trace, one per BitcoinNode trace source.
+ */
+enum TraceEventType
+{
+  BLOCK_MINED_TRACE,
+  BLOCK_RECEIVED_TRACE,
+  BLOCK_VALIDATED_TRACE,
+  ORPHAN_ADDED_TRACE,
+  TIMEOUT_FIRED_TRACE,
+  CHUNK_RECEIVED_TRACE,
+  MESSAGE_SENT_TRACE,
+  CHAIN_REORG_TRACE
+};
+
+
+/**
+ * A fixed-size record of the binary trace. The fields which do not apply to an event type are -1 (or 0 for peer and bytes).
+ */
+typedef struct {
+  int64_t  time;                   // The simulation time in ns
+  uint32_t nodeId;
+  uint32_t peer;                   // The raw Ipv4 address of the peer
+  int32_t  blockHeight;
+  int32_t  minerId;
+  int32_t  chunkId;
+  uint32_t bytes;                  // The block size for block events, the message size for MESSAGE_SENT_TRACE,
+                                   // the blocks which left the main chain for CHAIN_REORG_TRACE
+  uint16_t eventType;              // enum TraceEventType
+  uint16_t message;                // enum Messages for MESSAGE_SENT_TRACE
+  int32_t  oldTopHeight;           // The height of the replaced top block for CHAIN_REORG_TRACE, whose new top block
+                                   // is blockHeight/minerId
+} traceRecord;
+
+
+/**
+ * The header of a binary trace file. It is followed by the region of each node (noNodes uint32_t),
+ * zero padded to a multiple of 8 Bytes, and then by the batches of encoded traceRecords.
+ */
+typedef struct {
+  char     magic[8];               // "BTCTRACE"
+  uint32_t version;
+  uint32_t recordSize;             // sizeof(traceRecord)
+  uint32_t systemId;
+  uint32_t noNodes;
+} traceFileHeader;
+
+
+/**
+ * The header of a batch of traceRecords in a binary trace file. The records of a batch are encoded on their
+ * own, so the batches can be decoded in parallel: the time is the zigzag varint of the difference from the
+ * previous record of the batch (from 0 for the first one), and every other field is a varint, zigzag for
+ * the signed ones.
+ */
+typedef struct {
+  uint32_t noRecords;
+  uint32_t encodedBytes;           // The Bytes of the encoded records which follow the header
+} traceBatchHeader;
+
+
 typedef struct {
   double downloadSpeed;
   double uploadSpeed;
 } nodeInternetSpeeds;
 
 
+typedef struct {
+  int nodeId;                   // The node which has the interface with the address, -1 if the address is unknown
+  int peerIndex;                // The index of the address in the peers of the node at the other end of the link
+} ipv4AddressOwner;
+
+
 /**
  * Fuctions used to convert enumeration values to the corresponding strings.
  */
@@ -157,15 +388,266 @@ const char* getProtocolType(enum ProtocolType m);
 const char* getBitcoinRegion(enum BitcoinRegion m);
 const char* getCryptocurrency(enum Cryptocurrency m);
 enum BitcoinRegion getBitcoinEnum(uint32_t n);
+const char* getHandlerName(int handler);
+const char* getEventName(enum BitcoinEvent e);
+const char* getTraceEventName(enum TraceEventType t);
+const char* getHopDelayName(enum HopDelay d);
+
+/**
+ * Gets the offset of the first batch of traceRecords in a binary trace file with the regions of noNodes nodes
+ */
+size_t getTraceRecordsOffset(uint32_t noNodes);
+
+/**
+ * Appends the encoding of count records, as described in traceBatchHeader, to encoded
+ */
+void encodeTraceRecords(const traceRecord *records, size_t count, std::vector<uint8_t> &encoded);
+
+/**
+ * Decodes the noRecords records of a batch of encodedBytes Bytes into records. Returns false if the batch is corrupt.
+ */
+bool decodeTraceRecords(const uint8_t *encoded, size_t encodedBytes, uint32_t noRecords, std::vector<traceRecord> &records);
 
+/**
+ * Runs task(i) for every i in [0, n) on noThreads threads, each one taking a contiguous block of indices.
+ * The calling thread just waits, and with noThreads <= 1 the tasks run on it in order.
+ */
+void ParallelFor(uint32_t n, uint32_t noThreads, const std::function<void (uint32_t)> &task);
+
+
+#ifdef BITCOIN_HANDLER_PROFILING
+/**
+ * Times the handler it is constructed for until it goes out of scope, and accumulates the invocations
+ * and the wall clock time of each handler of this process. The times are inclusive, e.g. a BLOCK message
+ * also counts the ReceivedBlockMessage it runs directly.
+ */
+class HandlerProfile
+{
+public:
+  HandlerProfile (int handler);
+  ~HandlerProfile ();
+
+  /**
+   * Prints the invocations, the total and the mean time of the handlers which ran in this process
+   */
+  static void Print (std::ostream &out, uint32_t systemId);
+
+private:
+  int                                     m_handler;
+  std::chrono::steady_clock::time_point   m_start;
+
+  static long                             m_invocations[NO_HANDLERS];
+  static double                           m_time[NO_HANDLERS];
+};
+
+#define BITCOIN_PROFILE_HANDLER(handler) HandlerProfile handlerProfile (handler)
+#define BITCOIN_PRINT_HANDLER_PROFILE(out, systemId) HandlerProfile::Print (out, systemId)
+#else
+#define BITCOIN_PROFILE_HANDLER(handler)
+#define BITCOIN_PRINT_HANDLER_PROFILE(out, systemId)
+#endif
+
+
+/**
+ * Tags the events scheduled by the bitcoin applications with their kind. Once enabled, it counts how many
+ * events of each kind were scheduled, executed and cancelled in this process, and keeps a histogram of the
+ * simulated time the executed ones spent in the event queue. While disabled, Schedule and Cancel just
+ * forward to the Simulator. It must be enabled before the applications start.
+ *
+ * Independently, the load profile charges the wall clock time of every executed event to the
+ * processedEvents and processingTime statistics of the node which scheduled it.
+ */
+class EventCensus
+{
+public:
+  static void Enable (void);
+  static bool IsEnabled (void);
+
+  static void EnableLoadProfile (void);
+  static bool IsLoadProfileEnabled (void);
+
+  template <typename MEM, typename OBJ, typename... Ts>
+  static EventId Schedule (enum BitcoinEvent kind, const Time &delay, MEM mem_ptr, OBJ obj, Ts... args)
+  {
+    return DoSchedule (kind, delay, MakeEvent (mem_ptr, obj, args...), obj->GetNodeStats ());
+  }
+
+  /**
+   * Charges an event which started being handled at start to the load profile of a node
+   */
+  static void RecordLoad (nodeStatistics *stats, std::chrono::steady_clock::time_point start);
+
+  static void Cancel (enum BitcoinEvent kind, const EventId &event);
+
+  /**
+   * The totals over all the kinds of events
+   */
+  static long GetTotalExecuted (void);
+  static long GetTotalPending (void);
+
+  /**
+   * Prints the counts and the queue residency histogram of each kind of event
+   */
+  static void Print (std::ostream &out, uint32_t systemId);
+
+  static const int m_noResidencyBuckets = 7;       // <1ms, <10ms, ..., <100s, >=100s
+
+private:
+  /**
+   * Records the execution of the event it wraps
+   */
+  class CensusEvent : public EventImpl
+  {
+  public:
+    CensusEvent (enum BitcoinEvent kind, EventImpl *event, nodeStatistics *stats);
+  protected:
+    virtual void Notify (void);
+  private:
+    enum BitcoinEvent     m_kind;
+    Time                  m_scheduledAt;
+    Ptr<EventImpl>        m_event;
+    nodeStatistics       *m_stats;              // The load profile charged, nullptr if it is disabled
+  };
+
+  static EventId DoSchedule (enum BitcoinEvent kind, const Time &delay, EventImpl *event, nodeStatistics *stats);
+
+  static bool     m_enabled;
+  static bool     m_loadProfile;
+  static long     m_scheduled[NO_EVENTS];
+  static long     m_executed[NO_EVENTS];
+  static long     m_cancelled[NO_EVENTS];
+  static long     m_residency[NO_EVENTS][m_noResidencyBuckets];
+};
+
+
+class Application;
+
+/**
+ * Appends the events of the BitcoinNode trace sources as fixed-size traceRecords to a single-producer
+ * single-consumer ring buffer. A background thread drains the ring buffer, encodes the records in batches
+ * (see traceBatchHeader) and writes them to the trace file, so the simulation thread only copies a record
+ * and publishes it. If the writer falls behind, the simulation waits for free space instead of dropping
+ * records. Use one tracer per rank.
+ */
+class BinaryTracer
+{
+public:
+  BinaryTracer (void);
+  ~BinaryTracer (void);
+
+  /**
+   * \brief Creates the trace file and starts the writer thread
+   * \param fileName the trace file
+   * \param systemId the rank writing the trace
+   * \param nodesRegions the region of each node, stored in the header for the analysis tools
+   * \param noNodes the number of nodes
+   */
+  void Open (const std::string &fileName, uint32_t systemId, const uint32_t *nodesRegions, uint32_t noNodes);
+
+  /**
+   * \brief Writes the remaining records, stops the writer thread and closes the file
+   */
+  void Close (void);
+
+  /**
+   * \brief Subscribes the tracer to all the trace sources of a bitcoin node or miner
+   */
+  void Connect (Ptr<Application> node);
+
+  void BlockMined (const blockTrace &block);
+  void BlockReceived (const blockTrace &block);
+  void BlockValidated (const blockTrace &block);
+  void OrphanAdded (const blockTrace &block);
+  void TimeoutFired (const timeoutTrace &timeout);
+  void ChunkReceived (const chunkTrace &chunk);
+  void MessageSent (const messageTrace &message);
+  void ChainReorg (const reorgTrace &reorg);
+
+  uint64_t GetNoRecords (void) const;
+  uint64_t GetNoStalls (void) const;          //!< The times the ring buffer was full
+
+private:
+  BinaryTracer (const BinaryTracer &);
+  BinaryTracer &operator= (const BinaryTracer &);
+
+  void RecordBlock (enum TraceEventType type, const blockTrace &block);
+  void Append (const traceRecord &record);
+  void Drain (void);                          //!< The loop of the writer thread
+
+  static const uint32_t            m_capacity = 1 << 16;    //!< The records of the ring buffer, a power of 2
+
+  std::vector<traceRecord>         m_ring;
+  std::vector<uint8_t>             m_batch;                 //!< The encoding of the batch being written, owned by the writer thread
+  std::atomic<uint64_t>            m_head;                  //!< The next record written to the file
+  std::atomic<uint64_t>            m_tail;                  //!< The next record appended by the simulation
+  std::atomic<bool>                m_running;
+  std::thread                      m_writer;
+  FILE                            *m_file;
+  uint64_t                         m_stalls;
+};
+
+
+/**
+ * Periodically reports the progress of this rank: the simulated time, the height of the longest chain
+ * known to its nodes, the application events executed per wall clock second, the pending application
+ * events and the peak RSS. The reports are scheduled in simulated time, but written only if enough wall
+ * clock time has passed since the previous one. The event rates come from the EventCensus, which Start
+ * enables. In PROMETHEUS_TELEMETRY format the file is atomically replaced with the latest report, in
+ * JSON_LINES_TELEMETRY format every report is appended as a line.
+ */
+class RunTelemetry
+{
+public:
+  RunTelemetry (void);
+
+  /**
+   * \brief Schedules the first report
+   * \param fileName the telemetry file
+   * \param format the format of the reports
+   * \param systemId the rank reporting
+   * \param interval the simulated time between reports
+   * \param minWallInterval the minimum wall clock time between written reports, in seconds
+   */
+  void Start (const std::string &fileName, enum TelemetryFormat format, uint32_t systemId, Time interval, double minWallInterval);
+
+  /**
+   * \brief Cancels the next report and writes a final one
+   */
+  void Stop (void);
+
+  /**
+   * \brief Subscribes to the mined and validated blocks of a bitcoin node or miner, to follow the chain height
+   */
+  void Connect (Ptr<Application> node);
+
+private:
+  void Report (void);
+  void Write (double wallTime);
+  void BlockTraced (const blockTrace &block);
+
+  std::string               m_fileName;
+  enum TelemetryFormat      m_format;
+  uint32_t                  m_systemId;
+  Time                      m_interval;
+  double                    m_minWallInterval;
+  double                    m_startWallTime;
+  double                    m_lastWallTime;       //!< The wall clock time of the last written report
+  long                      m_lastExecuted;       //!< The executed events at the last written report
+  int                       m_chainHeight;
+  EventId                   m_nextReport;
+};
+
+/**
+ * A block record. It has no virtual functions and uses the implicit copy operations, so it is trivially
+ * copyable: the vectors of blocks held by the blockchain, the orphan pool and the messages are dense and
+ * are copied with memcpy. The sender is kept as the raw 4-Byte Ipv4 address.
+ */
 class Block
 {
 public:
   Block (int blockHeight, int minerId, int parentBlockMinerId = 0, int blockSizeBytes = 0, 
          double timeCreated = 0, double timeReceived = 0, Ipv4Address receivedFromIpv4 = Ipv4Address("0.0.0.0"));
   Block ();
-  Block (const Block &blockSource);  // Copy constructor
-  virtual ~Block (void);
  
   int GetBlockHeight (void) const;
   void SetBlockHeight (int blockHeight);
@@ -195,8 +677,6 @@ public:
    */
   bool IsChild (const Block &block) const; 
   
-  Block& operator= (const Block &blockSource); //Assignment Constructor
-  
   friend bool operator== (const Block &block1, const Block &block2);
   friend std::ostream& operator<< (std::ostream &out, const Block &block);
   
@@ -205,9 +685,9 @@ protected:
   int           m_minerId;                    // The id of the miner which mined this block
   int           m_parentBlockMinerId;         // The id of the miner which mined the parent of this block
   int           m_blockSizeBytes;             // The size of the block in bytes
+  uint32_t      m_receivedFromIpv4;           // The Ipv4 of the node which sent the block to the receiving node
   double        m_timeCreated;                // The time the block was created
   double        m_timeReceived;               // The time the block was received from the node
-  Ipv4Address   m_receivedFromIpv4;           // The Ipv4 of the node which sent the block to the receiving node
 };
 
 class BitcoinChunk : public Block
@@ -216,14 +696,10 @@ public:
   BitcoinChunk (int blockHeight, int minerId, int chunkId, int parentBlockMinerId = 0, int blockSizeBytes = 0, 
                 double timeCreated = 0, double timeReceived = 0, Ipv4Address receivedFromIpv4 = Ipv4Address("0.0.0.0"));
   BitcoinChunk ();
-  BitcoinChunk (const BitcoinChunk &chunkSource);  // Copy constructor
-  virtual ~BitcoinChunk (void);
  
   int GetChunkId (void) const;
   void SetChunkId (int minerId);
   
-  BitcoinChunk& operator= (const BitcoinChunk &chunkSource); //Assignment Constructor
-  
   friend bool operator== (const BitcoinChunk &chunk, const BitcoinChunk &chunk2);
   friend bool operator< (const BitcoinChunk &chunk, const BitcoinChunk &chunk2);
   friend std::ostream& operator<< (std::ostream &out, const BitcoinChunk &chunk);
@@ -233,6 +709,20 @@ protected:
 
 };
 
+/**
+ * Identifies a block by its height and the id of its miner, like the "height/minerId" block hashes.
+ */
+typedef std::pair<int, int> BlockId;
+
+struct BlockIdHash
+{
+  std::size_t operator() (const BlockId &id) const
+  {
+    return std::hash<long long> () ((static_cast<long long> (id.first) << 32) ^ static_cast<unsigned int> (id.second));
+  }
+};
+
+
 class Blockchain
 {
 public:
@@ -297,12 +787,18 @@ public:
   void AddBlock (const Block& newBlock);
 
   /**
-   * Adds a new orphan block in the blockchain.
+   * Sets the maximum number of orphans kept (0 for unlimited) and which orphan is evicted when the pool is full.
    */
-  void AddOrphan (const Block& newBlock);
+  void SetOrphanPoolLimits (int maxOrphans, enum OrphanEvictionPolicy evictionPolicy);
+
+  /**
+   * Adds a new orphan block in the blockchain. If the orphan pool is full, an orphan is evicted
+   * according to the eviction policy and returned; otherwise the returned block has height -1.
+   */
+  Block AddOrphan (const Block& newBlock);
   
   /**
-   * Removes a new orphan block in the blockchain.
+   * Removes a new orphan block in the blockchain, because its parent was received (i.e. the orphan was resolved).
    */
   void RemoveOrphan (const Block& newBlock);
   
@@ -312,27 +808,521 @@ public:
   void PrintOrphans (void);
 
   /**
-   * Gets the total number of blocks in forks.
+   * Gets the number of orphans that were removed because their parent was received.
+   */
+  long GetOrphansResolved (void) const;
+
+  /**
+   * Gets the number of orphans that were evicted because the orphan pool was full.
    */
-  int GetBlocksInForks (void);
+  long GetOrphansEvicted (void) const;
 
   /**
-   * Gets the longest fork size
+   * Gets the total number of blocks in forks, i.e. the blocks of the heights with more than one block.
+   * The fork metrics are updated incrementally by AddBlock, so they can be queried at any time in O(1).
    */
-  int GetLongestForkSize (void);
+  int GetBlocksInForks (void) const;
+
+  /**
+   * Gets the longest fork size, i.e. the longest chain of blocks which all have siblings
+   */
+  int GetLongestForkSize (void) const;
+
+  /**
+   * Gets the number of stale blocks at the specified height, or 0 if the height has been pruned
+   */
+  int GetNoStaleBlocks (int height) const;
+
+  /**
+   * Gets the number of times the current top block was replaced by a block which is not its child
+   */
+  int GetNoReorgs (void) const;
+
+  /**
+   * Gets the deepest reorganization, i.e. the maximum number of blocks which left the main chain at once
+   */
+  int GetMaxReorgDepth (void) const;
+
+  /**
+   * Gets the depth of the last reorganization, 0 if there was none
+   */
+  int GetLastReorgDepth (void) const;
+
+  /**
+   * Gets the ancestor of a block at the specified height, following the skip pointers in O(log n).
+   * Returns nullptr if the block or the ancestor is not in the blockchain.
+   */
+  const Block* GetAncestor (const Block &block, int height) const;
+
+  /**
+   * Gets the last common ancestor of two blocks (e.g. two competing tips), or nullptr if they have none in the blockchain.
+   */
+  const Block* GetCommonAncestor (const Block &block1, const Block &block2) const;
+
+  /**
+   * Checks if the block is in the chain ending at top.
+   */
+  bool IsInChain (const Block &block, const Block &top) const;
+
+  /**
+   * Checks if the block is in the main chain, i.e. the chain ending at the current top block.
+   */
+  bool IsInMainChain (const Block &block) const;
+
+  /**
+   * Gets the last noBlocks blocks of the chain ending at top, starting from the oldest one.
+   * Returns fewer blocks if the chain has fewer ancestors in the blockchain.
+   */
+  std::vector<Block> GetChain (const Block &top, int noBlocks) const;
+
+  /**
+   * Sets the pruning depth K (0 disables pruning). The heights more than K blocks below the top block are
+   * collapsed into a summary, so the blockchain keeps only the last K + 1 heights. The stale and fork
+   * counters remain exact, but blocks and reorganizations deeper than K are no longer visible.
+   */
+  void SetPruneDepth (int pruneDepth);
+
+  /**
+   * Gets the lowest height still kept in the blockchain (0 if nothing has been pruned)
+   */
+  int GetPrunedHeight (void) const;
+
+  /**
+   * Gets the number of pruned main chain blocks mined by the specified miner
+   */
+  int GetPrunedMainChainBlocks (int minerId) const;
 
   friend std::ostream& operator<< (std::ostream &out, Blockchain &blockchain);
 
 private:
+  /**
+   * The index entry of a block, kept next to m_blocks. parent and skip are the columns of the parent
+   * and of the skip ancestor (at GetSkipHeight) in their rows, -1 if they are not in the blockchain.
+   */
+  typedef struct {
+    int parent;
+    int skip;
+    int forkLength;
+  } BlockIndexEntry;
+
+  /**
+   * Gets the blocks (or the index entries) of the specified height, which must be between the pruned height and the top block.
+   */
+  std::vector<Block>& GetRow (int height) { return m_blocks[height - m_prunedHeight]; }
+  const std::vector<Block>& GetRow (int height) const { return m_blocks[height - m_prunedHeight]; }
+  std::vector<BlockIndexEntry>& GetIndexRow (int height) { return m_index[height - m_prunedHeight]; }
+  const std::vector<BlockIndexEntry>& GetIndexRow (int height) const { return m_index[height - m_prunedHeight]; }
+
+  /**
+   * Checks if a block of the specified height can no longer be connected to the blockchain, because the height of its parent has been pruned.
+   */
+  bool IsPruned (int height) const { return m_prunedHeight > 0 && height <= m_prunedHeight; }
+
+  /**
+   * Gets the number of blocks received so far at a pruned height, both collapsed and kept in m_blocks.
+   */
+  int GetPrunedRowSize (int height) const;
+
+  /**
+   * Collapses the heights more than m_pruneDepth blocks below the top block into the pruning summary.
+   */
+  void Prune (void);
+
+  /**
+   * Gets the height of the skip ancestor of a block at the specified height (same as Bitcoin's pskip).
+   */
+  static int GetSkipHeight (int height);
+
+  /**
+   * Gets the column of a block in its row of m_blocks, or -1 if it is not in the blockchain.
+   */
+  int GetIndex (const Block &block) const;
+
+  /**
+   * Gets the column of the parent of a block in its row of m_blocks, or -1 if the parent is not in the blockchain.
+   */
+  int GetParentIndex (const Block &block) const;
+
+  /**
+   * Gets the column of the ancestor at ancestorHeight of the block m_blocks[height][index], or -1 if it is not in the blockchain.
+   */
+  int GetAncestorIndex (int height, int index, int ancestorHeight) const;
+
+  /**
+   * Removes the orphan pointed by it from the orphan pool and its indices.
+   */
+  void EraseOrphan (std::list<Block>::iterator it);
+
+  /**
+   * Recomputes the skip pointer of the block m_blocks[height][index] and of all its descendants.
+   */
+  void UpdateSkipIndex (int height, int index);
+
+  /**
+   * Recomputes the fork length of the block m_blocks[height][index] and propagates the change to its children.
+   */
+  void UpdateForkLength (int height, int index);
+
   int                                m_noStaleBlocks;     //total number of stale blocks
   int                                m_totalBlocks;       //total number of blocks including the genesis block
-  std::vector<std::vector<Block>>    m_blocks;            //2d vector containing all the blocks of the blockchain. (row->blockHeight, col->sibling blocks)
-  std::vector<Block>                 m_orphans;           //vector containing the orphans
+  int                                m_blocksInForks;     //total number of blocks in heights with more than one block
+  int                                m_longestForkSize;   //the longest chain of blocks which all have siblings
+  int                                m_noReorgs;          //the number of reorganizations
+  int                                m_maxReorgDepth;     //the deepest reorganization
+  int                                m_lastReorgDepth;    //the depth of the last reorganization
+  std::deque<std::vector<Block>>     m_blocks;            //2d container with the blocks of the blockchain. (row->blockHeight - m_prunedHeight, col->sibling blocks)
+  std::deque<std::vector<BlockIndexEntry>>   m_index;  //the index entry of each block, with the same layout as m_blocks
+  int                                m_pruneDepth;        //the pruning depth K, 0 if pruning is disabled
+  int                                m_prunedHeight;      //the lowest height kept in m_blocks
+  int                                m_prunedBlocks;      //the number of blocks in the pruned heights
+  std::map<int, int>                 m_prunedMainChainBlocks;  //the number of pruned main chain blocks of each miner
+  std::vector<int>                   m_prunedRowSizes;    //the blocks of each height which are not in m_blocks, because the height was pruned or they arrived after it
+  std::list<Block>                   m_orphans;           //list containing the orphans, in the order they were received
+  std::unordered_map<BlockId, std::list<Block>::iterator, BlockIdHash>       m_orphanIndex;        //the orphans, indexed by their id
+  std::unordered_multimap<BlockId, std::list<Block>::iterator, BlockIdHash>  m_orphansByParent;    //the orphans, indexed by the id of their parent
+  int                                m_maxOrphans;        //the maximum number of orphans, 0 for unlimited
+  enum OrphanEvictionPolicy          m_orphanEvictionPolicy;  //the orphan evicted when the pool is full
+  long                               m_orphansResolved;   //the number of orphans whose parent was received
+  long                               m_orphansEvicted;    //the number of orphans evicted from the full pool
+
+
+};
+
+
+/**
+ * Sampler of piecewise constant distributions (the empirical block size, bandwidth, region and connection distributions),
+ * equivalent to std::piecewise_constant_distribution. It is built once using Vose's alias method and then
+ * draws in O(1) instead of binary searching the cumulative weights. Sample is const, so a single sampler
+ * can be shared by all the nodes.
+ */
+class AliasSampler
+{
+public:
+  AliasSampler (void);
+
+  /**
+   * Builds the sampler from the interval boundaries [firstInterval, lastInterval) and the weights of the
+   * resulting intervals, starting from firstWeight (same as std::piecewise_constant_distribution).
+   */
+  template <class IntervalIterator, class WeightIterator>
+  AliasSampler (IntervalIterator firstInterval, IntervalIterator lastInterval, WeightIterator firstWeight)
+    : m_intervals (firstInterval, lastInterval)
+  {
+    std::vector<double> weights;
+
+    if (m_intervals.size() > 1)
+      weights.assign (firstWeight, firstWeight + (m_intervals.size() - 1));
+    Build (weights);
+  }
+
+  virtual ~AliasSampler (void);
+
+  /**
+   * Draws a value: an interval is chosen with probability proportional to its weight and
+   * the value is uniformly distributed inside it.
+   */
+  template <class Generator>
+  double Sample (Generator &generator) const
+  {
+    std::uniform_real_distribution<double> uniform (0, 1);
+    double column = uniform (generator) * m_aliases.size();
+    size_t bin = std::min (static_cast<size_t> (column), m_aliases.size() - 1);
 
+    if (column - bin >= m_probabilities[bin])
+      bin = m_aliases[bin];
 
+    return m_intervals[bin] + uniform (generator) * (m_intervals[bin + 1] - m_intervals[bin]);
+  }
+
+  /**
+   * Gets the number of intervals.
+   */
+  size_t GetNoIntervals (void) const;
+
+private:
+  /**
+   * Builds the probability and alias tables.
+   */
+  void Build (const std::vector<double> &weights);
+
+  std::vector<double>      m_intervals;         // The interval boundaries
+  std::vector<double>      m_probabilities;     // The probability of keeping each column's own interval
+  std::vector<uint32_t>    m_aliases;           // The interval chosen otherwise
+};
+
+
+/**
+ * The protocol constants, shared by all the supported cryptocurrencies. They are compile-time constants,
+ * so they are not copied into every node.
+ */
+struct ProtocolProfile
+{
+  static constexpr int      bitcoinPort = 8333;                  //!< 8333
+  static constexpr int      secondsPerMin = 60;                  //!< 60
+  static constexpr int      countBytes = 4;                      //!< The size of count variable in messages, 4 Bytes
+  static constexpr int      bitcoinMessageHeader = 90;           //!< The size of the bitcoin Message Header, 90 Bytes, including both the bitcoinMessageHeaders and the other protocol headers (TCP, IP, Ethernet)
+  static constexpr int      inventorySizeBytes = 36;             //!< The size of inventories in INV messages, 36 Bytes
+  static constexpr int      getHeadersSizeBytes = 72;            //!< The size of the GET_HEADERS message, 72 Bytes
+  static constexpr int      headersSizeBytes = 81;               //!< 81 Bytes
+  static constexpr int      blockHeadersSizeBytes = 81;          //!< 81 Bytes
+  static constexpr double   averageTransactionSize = 522.4;      //!< The average transaction size. Needed for compressed blocks
+  static constexpr int      transactionIndexSize = 2;            //!< The transaction index size in bytes. Needed for compressed blocks
+};
+
+
+/**
+ * The compile-time profile of each cryptocurrency. Apart from the protocol constants, it contains
+ * the empirical block size distribution (in KBytes) of the cryptocurrency.
+ */
+template <enum Cryptocurrency cryptocurrency>
+struct CryptocurrencyProfile;
+
+template <>
+struct CryptocurrencyProfile<BITCOIN> : public ProtocolProfile
+{
+  static constexpr double   blockSizeIntervals[201] = {
+    0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 65, 70, 75, 80, 85, 90, 95, 100, 105, 110, 115, 120, 125,
+    130, 135, 140, 145, 150, 155, 160, 165, 170, 175, 180, 185, 190, 195, 200, 205, 210, 215, 220, 225, 230, 235,
+    240, 245, 250, 255, 260, 265, 270, 275, 280, 285, 290, 295, 300, 305, 310, 315, 320, 325, 330, 335, 340, 345,
+    350, 355, 360, 365, 370, 375, 380, 385, 390, 395, 400, 405, 410, 415, 420, 425, 430, 435, 440, 445, 450, 455,
+    460, 465, 470, 475, 480, 485, 490, 495, 500, 505, 510, 515, 520, 525, 530, 535, 540, 545, 550, 555, 560, 565,
+    570, 575, 580, 585, 590, 595, 600, 605, 610, 615, 620, 625, 630, 635, 640, 645, 650, 655, 660, 665, 670, 675,
+    680, 685, 690, 695, 700, 705, 710, 715, 720, 725, 730, 735, 740, 745, 750, 755, 760, 765, 770, 775, 780, 785,
+    790, 795, 800, 805, 810, 815, 820, 825, 830, 835, 840, 845, 850, 855, 860, 865, 870, 875, 880, 885, 890, 895,
+    900, 905, 910, 915, 920, 925, 930, 935, 940, 945, 950, 955, 960, 965, 970, 975, 980, 985, 990, 995, 1000};
+  static constexpr double   blockSizeWeights[200] = {
+    4.96, 0.21, 0.17, 0.25, 0.27, 0.3, 0.34, 0.26, 0.26, 0.33, 0.35, 0.49, 0.42, 0.42, 0.48, 0.41, 0.46, 0.45,
+    0.58, 0.58, 0.57, 0.52, 0.54, 0.47, 0.53, 0.56, 0.5, 0.48, 0.53, 0.54, 0.49, 0.51, 0.56, 0.53, 0.56, 0.5,
+    0.47, 0.45, 0.52, 0.43, 0.46, 0.47, 0.6, 0.53, 0.42, 0.48, 0.55, 0.49, 0.63, 2.38, 0.47, 0.53, 0.43, 0.51,
+    0.44, 0.46, 0.44, 0.41, 0.47, 0.46, 0.45, 0.37, 0.49, 0.4, 0.41, 0.41, 0.41, 0.37, 0.43, 0.47, 0.48, 0.37,
+    0.4, 0.46, 0.34, 0.35, 0.37, 0.36, 0.37, 0.31, 0.35, 0.39, 0.34, 0.38, 0.29, 0.41, 0.37, 0.34, 0.36, 0.34,
+    0.29, 0.3, 0.36, 0.26, 0.29, 0.31, 0.3, 0.29, 0.35, 0.5, 0.28, 0.37, 0.31, 0.33, 0.32, 0.28, 0.34, 0.31,
+    0.26, 0.24, 0.22, 0.25, 0.24, 0.25, 0.26, 0.25, 0.24, 0.33, 0.24, 0.23, 0.2, 0.24, 0.26, 0.27, 0.27, 0.21,
+    0.22, 0.3, 0.25, 0.21, 0.26, 0.21, 0.21, 0.21, 0.23, 0.48, 0.2, 0.19, 0.21, 0.2, 0.17, 0.19, 0.21, 0.22,
+    0.24, 0.25, 0.23, 0.31, 0.46, 8.32, 0.22, 0.11, 0.13, 0.17, 0.12, 0.16, 0.15, 0.16, 0.19, 0.21, 0.18, 0.24,
+    0.19, 0.2, 0.16, 0.17, 0.19, 0.17, 0.22, 0.33, 0.17, 0.22, 0.25, 0.19, 0.2, 0.17, 0.28, 0.25, 0.24, 0.25, 0.3,
+    0.34, 0.46, 0.49, 0.67, 3.13, 2.94, 0.14, 0.36, 3.88, 0.07, 0.11, 0.11, 0.11, 0.26, 0.12, 0.13, 0.88, 5.84, 4.11};
+};
+
+template <>
+struct CryptocurrencyProfile<LITECOIN> : public ProtocolProfile
+{
+  static constexpr double   blockSizeIntervals[201] = {
+    0.0, 0.5, 1.0, 1.5, 2.0, 2.5, 3.0, 3.5, 4.0, 4.5, 5.0, 5.5, 6.0, 6.5, 7.0, 7.5, 8.0, 8.5, 9.0, 9.5, 10.0,
+    10.5, 11.0, 11.5, 12.0, 12.5, 13.0, 13.5, 14.0, 14.5, 15.0, 15.5, 16.0, 16.5, 17.0, 17.5, 18.0, 18.5, 19.0, 19.5,
+    20.0, 20.5, 21.0, 21.5, 22.0, 22.5, 23.0, 23.5, 24.0, 24.5, 25.0, 25.5, 26.0, 26.5, 27.0, 27.5, 28.0, 28.5, 29.0,
+    29.5, 30.0, 30.5, 31.0, 31.5, 32.0, 32.5, 33.0, 33.5, 34.0, 34.5, 35.0, 35.5, 36.0, 36.5, 37.0, 37.5, 38.0, 38.5,
+    39.0, 39.5, 40.0, 40.5, 41.0, 41.5, 42.0, 42.5, 43.0, 43.5, 44.0, 44.5, 45.0, 45.5, 46.0, 46.5, 47.0, 47.5, 48.0,
+    48.5, 49.0, 49.5, 50.0, 50.5, 51.0, 51.5, 52.0, 52.5, 53.0, 53.5, 54.0, 54.5, 55.0, 55.5, 56.0, 56.5, 57.0, 57.5,
+    58.0, 58.5, 59.0, 59.5, 60.0, 60.5, 61.0, 61.5, 62.0, 62.5, 63.0, 63.5, 64.0, 64.5, 65.0, 65.5, 66.0, 66.5, 67.0,
+    67.5, 68.0, 68.5, 69.0, 69.5, 70.0, 70.5, 71.0, 71.5, 72.0, 72.5, 73.0, 73.5, 74.0, 74.5, 75.0, 75.5, 76.0, 76.5,
+    77.0, 77.5, 78.0, 78.5, 79.0, 79.5, 80.0, 80.5, 81.0, 81.5, 82.0, 82.5, 83.0, 83.5, 84.0, 84.5, 85.0, 85.5, 86.0,
+    86.5, 87.0, 87.5, 88.0, 88.5, 89.0, 89.5, 90.0, 90.5, 91.0, 91.5, 92.0, 92.5, 93.0, 93.5, 94.0, 94.5, 95.0, 95.5,
+    96.0, 96.5, 97.0, 97.5, 98.0, 98.5, 99.0, 99.5, 100.0};
+  static constexpr double   blockSizeWeights[200] = {
+    38.91, 5.76, 4.97, 4.11, 3.4, 3.13, 2.77, 2.36, 2.24, 2.04, 1.85, 1.74, 1.55, 1.47, 1.32, 1.19, 1.1, 1.0, 0.89,
+    0.87, 0.82, 0.75, 0.73, 0.63, 0.61, 0.61, 0.53, 0.52, 0.52, 0.56, 0.47, 0.48, 0.45, 0.39, 0.4, 0.37, 0.37, 0.34,
+    0.32, 0.34, 0.32, 0.27, 0.32, 0.32, 0.3, 0.26, 0.25, 0.35, 0.89, 0.18, 0.12, 0.11, 0.1, 0.1, 0.09, 0.1, 0.09, 0.1,
+    0.09, 0.1, 0.08, 0.08, 0.07, 0.07, 0.05, 0.07, 0.07, 0.06, 0.06, 0.06, 0.05, 0.05, 0.04, 0.05, 0.03, 0.05, 0.04,
+    0.04, 0.04, 0.04, 0.04, 0.05, 0.03, 0.03, 0.04, 0.02, 0.03, 0.02, 0.02, 0.03, 0.03, 0.03, 0.03, 0.03, 0.03, 0.02,
+    0.05, 0.09, 0.01, 0.02, 0.02, 0.02, 0.01, 0.01, 0.01, 0.02, 0.01, 0.01, 0.02, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01,
+    0.01, 0.02, 0.01, 0.01, 0.01, 0.01, 0.02, 0.0, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.0, 0.01, 0.01, 0.01, 0.01,
+    0.01, 0.01, 0.01, 0.01, 0.0, 0.01, 0.01, 0.0, 0.0, 0.01, 0.01, 0.01, 0.0, 0.0, 0.0, 0.01, 0.01, 0.01, 0.01, 0.01,
+    0.0, 0.0, 0.0, 0.01, 0.0, 0.01, 0.0, 0.0, 0.01, 0.0, 0.0, 0.0, 0.01, 0.01, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+    0.01, 0.0, 0.01, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.01, 0.0, 0.0, 0.0, 0.0, 0.01, 0.0,
+    0.0, 0.24};
+};
+
+template <>
+struct CryptocurrencyProfile<DOGECOIN> : public ProtocolProfile
+{
+  static constexpr double   blockSizeIntervals[201] = {
+    0.0, 0.5, 1.0, 1.5, 2.0, 2.5, 3.0, 3.5, 4.0, 4.5, 5.0, 5.5, 6.0, 6.5, 7.0, 7.5, 8.0, 8.5, 9.0, 9.5, 10.0,
+    10.5, 11.0, 11.5, 12.0, 12.5, 13.0, 13.5, 14.0, 14.5, 15.0, 15.5, 16.0, 16.5, 17.0, 17.5, 18.0, 18.5, 19.0, 19.5,
+    20.0, 20.5, 21.0, 21.5, 22.0, 22.5, 23.0, 23.5, 24.0, 24.5, 25.0, 25.5, 26.0, 26.5, 27.0, 27.5, 28.0, 28.5, 29.0,
+    29.5, 30.0, 30.5, 31.0, 31.5, 32.0, 32.5, 33.0, 33.5, 34.0, 34.5, 35.0, 35.5, 36.0, 36.5, 37.0, 37.5, 38.0, 38.5,
+    39.0, 39.5, 40.0, 40.5, 41.0, 41.5, 42.0, 42.5, 43.0, 43.5, 44.0, 44.5, 45.0, 45.5, 46.0, 46.5, 47.0, 47.5, 48.0,
+    48.5, 49.0, 49.5, 50.0, 50.5, 51.0, 51.5, 52.0, 52.5, 53.0, 53.5, 54.0, 54.5, 55.0, 55.5, 56.0, 56.5, 57.0, 57.5,
+    58.0, 58.5, 59.0, 59.5, 60.0, 60.5, 61.0, 61.5, 62.0, 62.5, 63.0, 63.5, 64.0, 64.5, 65.0, 65.5, 66.0, 66.5, 67.0,
+    67.5, 68.0, 68.5, 69.0, 69.5, 70.0, 70.5, 71.0, 71.5, 72.0, 72.5, 73.0, 73.5, 74.0, 74.5, 75.0, 75.5, 76.0, 76.5,
+    77.0, 77.5, 78.0, 78.5, 79.0, 79.5, 80.0, 80.5, 81.0, 81.5, 82.0, 82.5, 83.0, 83.5, 84.0, 84.5, 85.0, 85.5, 86.0,
+    86.5, 87.0, 87.5, 88.0, 88.5, 89.0, 89.5, 90.0, 90.5, 91.0, 91.5, 92.0, 92.5, 93.0, 93.5, 94.0, 94.5, 95.0, 95.5,
+    96.0, 96.5, 97.0, 97.5, 98.0, 98.5, 99.0, 99.5, 100.0};
+  static constexpr double   blockSizeWeights[200] = {
+    16.38, 9.75, 7.9, 6.45, 5.51, 4.78, 4.13, 3.52, 3.12, 2.76, 2.48, 2.2, 1.88, 1.77, 1.59, 1.47, 1.31, 1.22, 1.11,
+    1.02, 0.92, 0.86, 0.76, 0.73, 0.68, 0.61, 0.6, 0.56, 0.53, 0.5, 0.52, 0.51, 0.51, 0.47, 0.46, 0.43, 0.41, 0.4,
+    0.38, 0.36, 0.34, 0.33, 0.3, 0.29, 0.27, 0.25, 0.27, 0.24, 0.23, 0.2, 0.2, 0.19, 0.17, 0.16, 0.16, 0.15, 0.14,
+    0.12, 0.14, 0.13, 0.11, 0.13, 0.11, 0.11, 0.09, 0.1, 0.08, 0.08, 0.07, 0.07, 0.07, 0.07, 0.06, 0.07, 0.07, 0.05,
+    0.06, 0.06, 0.05, 0.06, 0.06, 0.05, 0.04, 0.04, 0.04, 0.04, 0.04, 0.03, 0.04, 0.04, 0.03, 0.03, 0.03, 0.03, 0.03,
+    0.03, 0.03, 0.04, 0.04, 0.03, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02,
+    0.02, 0.01, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.02, 0.01, 0.02, 0.01, 0.02,
+    0.01, 0.01, 0.01, 0.01, 0.02, 0.01, 0.02, 0.02, 0.02, 0.02, 0.01, 0.01, 0.02, 0.01, 0.01, 0.02, 0.01, 0.02, 0.01,
+    0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01,
+    0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01,
+    0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.01, 0.02, 0.41};
+};
+
+
+/**
+ * Gets the block size distribution (in KBytes) of a cryptocurrency. The sampler is built once from
+ * the constexpr tables of its profile and it is shared by all the miners.
+ */
+template <enum Cryptocurrency cryptocurrency>
+const AliasSampler &
+GetBlockSizeSampler (void)
+{
+  typedef CryptocurrencyProfile<cryptocurrency> Profile;
+  static const AliasSampler blockSizeSampler (std::begin (Profile::blockSizeIntervals), std::end (Profile::blockSizeIntervals),
+                                              std::begin (Profile::blockSizeWeights));
+  return blockSizeSampler;
+}
+
+const AliasSampler &GetBlockSizeSampler (enum Cryptocurrency cryptocurrency);
+
+
+/**
+ * Hierarchical timer wheel holding string-keyed timeouts (e.g. the timeouts of the requested blocks and chunks).
+ * Arming and cancelling a timeout is O(1). The wheel does not schedule any events by itself; its owner calls
+ * Advance once per tick and handles the expired keys.
+ */
+class TimerWheel
+{
+public:
+  TimerWheel (void);
+  virtual ~TimerWheel (void);
+
+  /**
+   * Arms the timeout of key, so that it expires after the given number of ticks (at least 1).
+   * If the timeout of key is already armed, it is re-armed.
+   */
+  void Arm (const std::string &key, uint64_t ticks);
+
+  /**
+   * Cancels the timeout of key. Returns false if the timeout was not armed.
+   */
+  bool Cancel (const std::string &key);
+
+  /**
+   * Checks if the timeout of key is armed.
+   */
+  bool IsArmed (const std::string &key) const;
+
+  bool IsEmpty (void) const;
+  size_t GetSize (void) const;
+  uint64_t GetCurrentTick (void) const;
+
+  /**
+   * Gets the keys of all the armed timeouts.
+   */
+  std::vector<std::string> GetArmedKeys (void) const;
+
+  /**
+   * Advances the wheel by one tick and returns the keys which expired, in the order they were armed.
+   * The expired timeouts are no longer armed.
+   */
+  std::vector<std::string> Advance (void);
+
+private:
+  struct Timer
+  {
+    uint64_t                          expiry;       // The tick at which the timeout expires
+    int                               level;        // The level of the wheel holding the timeout
+    int                               slot;         // The slot of the level holding the timeout
+    std::list<std::string>::iterator  position;     // The position of the key in the slot
+  };
+
+  /**
+   * Moves the key pointed by it from the list from to the slot matching the expiry tick.
+   */
+  void Place (std::list<std::string> &from, std::list<std::string>::iterator it, uint64_t expiry);
+
+  /**
+   * Redistributes the timeouts of the current slot of level to the lower levels.
+   */
+  void Cascade (int level);
+
+  static const int                                    m_slotBits = 6;                   // Each level has 2^m_slotBits slots
+  static const int                                    m_noSlots = 1 << m_slotBits;      // The number of slots per level
+  static const int                                    m_noLevels = 4;                   // Covers 2^(m_slotBits*m_noLevels) ticks
+
+  uint64_t                                            m_currentTick;                    // The number of ticks the wheel has advanced
+  std::list<std::string>                              m_slots[m_noLevels][m_noSlots];   // The keys of the armed timeouts per level and slot
+  std::unordered_map<std::string, Timer>              m_timers;                         // The armed timeouts
+};
+
+
+/**
+ * Read-only view of a contiguous range of elements (e.g. the slice of a BitcoinTopology array belonging to a node).
+ * It does not own the elements, so whoever owns them must outlive the span.
+ */
+template <typename T>
+class Span
+{
+public:
+  typedef const T* const_iterator;
+
+  Span (void) : m_data (0), m_size (0) {}
+  Span (const T *data, size_t size) : m_data (data), m_size (size) {}
+  Span (const std::vector<T> &elements) : m_data (elements.data ()), m_size (elements.size ()) {}
+
+  const_iterator begin (void) const { return m_data; }
+  const_iterator end (void) const { return m_data + m_size; }
+  size_t size (void) const { return m_size; }
+  bool empty (void) const { return m_size == 0; }
+  const T &operator[] (size_t i) const { return m_data[i]; }
+
+private:
+  const T  *m_data;       // The first element of the range
+  size_t    m_size;       // The number of elements in the range
 };
 
 
+/**
+ * Immutable peer topology of the network. It is built once by BitcoinTopologyHelper and shared by all the
+ * installed applications. The connections are kept in compressed sparse row form: the peers of node n are the
+ * entries [m_offsets[n], m_offsets[n + 1]) of the per-connection arrays, so applications get spans instead of copies.
+ */
+class BitcoinTopology : public SimpleRefCount<BitcoinTopology>
+{
+public:
+  /**
+   * \param offsets the first connection of each node, followed by the total number of connections
+   * \param peersAddresses the address of the peer of each connection
+   * \param peersNodeIds the node id of the peer of each connection
+   * \param peersDownloadSpeeds the download speed of the peer of each connection in Mbps
+   * \param peersUploadSpeeds the upload speed of the peer of each connection in Mbps
+   * \param nodesInternetSpeeds the internet speeds of each node
+   */
+  BitcoinTopology (std::vector<uint32_t> offsets, std::vector<Ipv4Address> peersAddresses, std::vector<uint32_t> peersNodeIds,
+                   std::vector<double> peersDownloadSpeeds, std::vector<double> peersUploadSpeeds,
+                   std::vector<nodeInternetSpeeds> nodesInternetSpeeds);
+
+  uint32_t GetNoNodes (void) const;
+  uint32_t GetNoConnections (void) const;
+
+  Span<Ipv4Address> GetPeersAddresses (uint32_t nodeId) const;
+  Span<uint32_t> GetPeersNodeIds (uint32_t nodeId) const;
+  Span<double> GetPeersDownloadSpeeds (uint32_t nodeId) const;
+  Span<double> GetPeersUploadSpeeds (uint32_t nodeId) const;
+  const nodeInternetSpeeds &GetNodeInternetSpeeds (uint32_t nodeId) const;
+
+  /**
+   * Maps an interface address back to its node and to its index in the peers of the node at the other end
+   * of the link, in O(log(connections)). Returns nodeId = peerIndex = -1 if the address is not in the topology.
+   */
+  ipv4AddressOwner GetAddressOwner (Ipv4Address address) const;
+
+private:
+  std::vector<uint32_t>            m_offsets;               // The first connection of each node, size = noNodes + 1
+  std::vector<Ipv4Address>         m_peersAddresses;        // The address of the peer of each connection
+  std::vector<uint32_t>            m_peersNodeIds;          // The node id of the peer of each connection
+  std::vector<uint32_t>            m_connectionsNodeIds;    // The node id owning each connection
+  std::vector<std::pair<uint32_t, uint32_t>>  m_addressIndex;  // (address, connection) of all the connections, sorted by address
+  std::vector<double>              m_peersDownloadSpeeds;   // The download speed of the peer of each connection
+  std::vector<double>              m_peersUploadSpeeds;     // The upload speed of the peer of each connection
+  std::vector<nodeInternetSpeeds>  m_nodesInternetSpeeds;   // The internet speeds of each node
+};
+
 }// Namespace ns3
 
 #endif /* BITCOIN_H */